@@ -0,0 +1,164 @@
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+/*
+    Function to prepare an empty arena; no memory is taken until the first
+    allocation
+*/
+void arenaInit(Arena* arena, size_t blockSize) {
+  arena->first = NULL;
+  arena->current = NULL;
+  arena->blockSize = blockSize;
+}
+
+/*
+    Function to allocate a block with room for at least size bytes
+*/
+ArenaBlock* newArenaBlock(Arena* arena, size_t size) {
+  size_t blockSize = size > arena->blockSize ? size : arena->blockSize;
+  ArenaBlock* block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + blockSize);
+  if (block == NULL) {
+    fprintf(stderr, "Memory allocation failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  block->next = NULL;
+  block->size = blockSize;
+  block->used = 0;
+  return block;
+}
+
+/*
+    Function to get the offset of the next free byte of a block whose address
+    is a multiple of alignment; the offset alone is not enough because the
+    data does not start at an aligned address itself
+*/
+size_t alignedOffset(ArenaBlock* block, size_t alignment) {
+  uintptr_t next = (uintptr_t)(block->data + block->used);
+  uintptr_t aligned = (next + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  return block->used + (aligned - next);
+}
+
+/*
+    Function to bump-allocate size bytes at the given alignment, moving on to
+    the next block (reusing one kept from before a reset if it is big enough)
+    when the current one is full
+*/
+void* arenaAllocAligned(Arena* arena, size_t size, size_t alignment) {
+  if (arena->current == NULL) {
+    if (arena->first == NULL) {
+      arena->first = newArenaBlock(arena, size + alignment);
+    }
+    arena->current = arena->first;
+  }
+
+  ArenaBlock* block = arena->current;
+  size_t offset = alignedOffset(block, alignment);
+  if (offset + size > block->size) {
+    ArenaBlock* next = block->next;
+    if (next == NULL || next->size < size + alignment) {
+      // an oversized request gets a block of its own, kept in the chain
+      ArenaBlock* fresh = newArenaBlock(arena, size + alignment);
+      fresh->next = next;
+      block->next = fresh;
+      next = fresh;
+    }
+    next->used = 0;
+    arena->current = next;
+    block = next;
+    offset = alignedOffset(block, alignment);
+  }
+  block->used = offset + size;
+  return block->data + offset;
+}
+
+/*
+    Function to allocate memory aligned for any type
+*/
+void* arenaAlloc(Arena* arena, size_t size) {
+  return arenaAllocAligned(arena, size, alignof(max_align_t));
+}
+
+/*
+    Function to copy a string into the arena
+*/
+char* arenaStrdup(Arena* arena, const char* s) {
+  size_t size = strlen(s) + 1;
+  char* p = (char*)arenaAllocAligned(arena, size, 1);
+  memcpy(p, s, size);
+  return p;
+}
+
+/*
+    Function to move the blocks a donor arena has allocated from into arena,
+    so what the donor holds lives until arena is reset; the donor gets as many
+    of arena's unused blocks in exchange and starts over empty
+*/
+void arenaAdopt(Arena* arena, Arena* donor) {
+  if (donor->current == NULL) {
+    return;
+  }
+  ArenaBlock* taken = donor->first;
+  ArenaBlock* takenLast = donor->current;
+  ArenaBlock* donorSpare = takenLast->next;
+  int count = 1;
+  for (ArenaBlock* block = taken; block != takenLast; block = block->next) {
+    count++;
+  }
+
+  // the blocks after arena's current one are free; the taken blocks go in
+  // front of them and allocation carries on after the donor's data
+  ArenaBlock* spare;
+  if (arena->current == NULL) {
+    spare = arena->first;
+    arena->first = taken;
+  } else {
+    spare = arena->current->next;
+    arena->current->next = taken;
+  }
+  arena->current = takenLast;
+
+  ArenaBlock* given = spare;
+  ArenaBlock* givenLast = NULL;
+  for (int i = 0; i < count && spare != NULL; i++) {
+    givenLast = spare;
+    spare = spare->next;
+  }
+  takenLast->next = spare;
+  if (givenLast != NULL) {
+    givenLast->next = donorSpare;
+    donor->first = given;
+  } else {
+    donor->first = donorSpare;
+  }
+  donor->current = NULL;
+  arenaReset(donor);
+}
+
+/*
+    Function to release everything allocated from the arena in O(1); the
+    blocks stay around for the allocations that follow
+*/
+void arenaReset(Arena* arena) {
+  if (arena->first != NULL) {
+    arena->first->used = 0;
+  }
+  arena->current = arena->first;
+}
+
+/*
+    Function to give the arena's blocks back to the system
+*/
+void arenaFree(Arena* arena) {
+  ArenaBlock* block = arena->first;
+  while (block != NULL) {
+    ArenaBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->first = NULL;
+  arena->current = NULL;
+}
@@ -0,0 +1,37 @@
+#include <stddef.h>
+// size of the blocks an arena carves allocations out of
+#define ARENA_BLOCK_SIZE (16 * 1024)
+
+#ifndef ARENA_H
+#define ARENA_H
+
+typedef struct ArenaBlock {
+  struct ArenaBlock* next;
+  size_t size;
+  size_t used;
+  char data[];
+} ArenaBlock;
+
+// a bump allocator: allocations are never freed one by one, the whole arena
+// is reset at once and its blocks are reused by the next round of allocations
+typedef struct {
+  ArenaBlock* first;
+  ArenaBlock* current;
+  size_t blockSize;
+} Arena;
+
+void arenaInit(Arena* arena, size_t blockSize);
+
+void* arenaAllocAligned(Arena* arena, size_t size, size_t alignment);
+
+void* arenaAlloc(Arena* arena, size_t size);
+
+char* arenaStrdup(Arena* arena, const char* s);
+
+void arenaAdopt(Arena* arena, Arena* donor);
+
+void arenaReset(Arena* arena);
+
+void arenaFree(Arena* arena);
+
+#endif
@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+
+# Measures GB/s through `cat big | cmd | wc -c` and `cat a > b` for the builtin
+# cat and /bin/cat, with the default pipe capacity and with `set pipesize=1M`.
+# The pipeline ends in wc -c so every byte is read by a real consumer; a cat
+# writing to /dev/null would only measure how fast the kernel discards data.
+#
+#   env python3 bench/pipe_bench.py [megabytes] [runs]
+
+import os
+import subprocess as proc
+import sys
+import tempfile
+import time
+
+SHELL = "./shell"
+
+def run(script, size, runs):
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        proc.run([SHELL], input = script.encode('ascii'),
+                 stdout = proc.DEVNULL, stderr = proc.DEVNULL, check = True)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return size / best / 1e9
+
+def main():
+    megabytes = int(sys.argv[1]) if len(sys.argv) > 1 else 1024
+    runs = int(sys.argv[2]) if len(sys.argv) > 2 else 3
+    size = megabytes * 1024 * 1024
+
+    with tempfile.TemporaryDirectory() as directory:
+        big = os.path.join(directory, "big")
+        copy = os.path.join(directory, "copy")
+        with open(big, "wb") as f:
+            for _ in range(megabytes):
+                f.write(os.urandom(1024 * 1024))
+
+        cases = []
+        for pipes in ("", "set pipesize=1M\n"):
+            suffix = ", 1M pipes" if pipes else ""
+            for left, right in (("/bin/cat", "/bin/cat"), ("cat", "/bin/cat"),
+                                ("cat", "cat")):
+                cases.append((f"{left} big | {right} | wc -c{suffix}",
+                              f"{pipes}{left} {big} | {right} | wc -c\n"))
+        cases.append(("/bin/cat a > b", f"/bin/cat {big} > {copy}\n"))
+        cases.append(("cat a > b", f"cat {big} > {copy}\n"))
+
+        print(f"{megabytes} MiB, best of {runs}")
+        for name, script in cases:
+            print(f"{name:42} {run(script, size, runs):6.2f} GB/s")
+
+if __name__ == '__main__':
+    main()
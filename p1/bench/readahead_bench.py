@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+
+# Times a generated script of cheap commands through the shell with the
+# reader thread on and off (MINISHELL_READAHEAD=0), both as piped stdin and
+# through `source`.
+#
+#   env python3 bench/readahead_bench.py [commands] [runs]
+
+import os
+import subprocess as proc
+import sys
+import tempfile
+import time
+
+SHELL = "./shell"
+
+def run(script, env_value, runs):
+    env = dict(os.environ, MINISHELL_READAHEAD = env_value)
+    best = None
+    for _ in range(runs):
+        start = time.perf_counter()
+        proc.run([SHELL], input = script, env = env,
+                 stdout = proc.DEVNULL, stderr = proc.DEVNULL, check = True)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return best
+
+def main():
+    commands = int(sys.argv[1]) if len(sys.argv) > 1 else 100000
+    runs = int(sys.argv[2]) if len(sys.argv) > 2 else 3
+
+    # `true` is about as cheap as a command gets here; a quoted argument and a
+    # couple of extra tokens give the tokenizer something to do
+    lines = ['true "cheap command %d" with a few args\n' % i
+             for i in range(commands)]
+    script = "".join(lines).encode('ascii')
+
+    with tempfile.NamedTemporaryFile(suffix = ".sh") as f:
+        f.write(script)
+        f.flush()
+        sourced = ("source %s\n" % f.name).encode('ascii')
+
+        print(f"{commands} commands, best of {runs}")
+        for name, inp in (("piped stdin", script), ("source", sourced)):
+            off = run(inp, "0", runs)
+            on = run(inp, "1", runs)
+            print(f"{name:12} line by line {off:8.3f}s  "
+                  f"readahead {on:8.3f}s  speedup {off / on:5.2f}x")
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,566 @@
+#include "shell.h"
+#include "tokens.h"
+#include "bytecode.h"
+
+// words that end the command list of a block in progress; the last one is
+// the keyword the block cannot do without
+char* conditionStops[] = {"then", NULL};
+char* loopConditionStops[] = {"do", NULL};
+char* branchStops[] = {"elif", "else", "fi", NULL};
+char* elseStops[] = {"fi", NULL};
+char* bodyStops[] = {"done", NULL};
+
+// to check whether a token, at the start of a command, is followed by the
+// start of another command
+bool isCommandStartKeyword(char* token) {
+  return strcmp(token, "if") == 0 || strcmp(token, "then") == 0 ||
+         strcmp(token, "elif") == 0 || strcmp(token, "else") == 0 ||
+         strcmp(token, "while") == 0 || strcmp(token, "do") == 0;
+}
+
+// to check whether a token is a keyword that cannot start a command
+bool isReservedWord(char* token) {
+  return strcmp(token, "then") == 0 || strcmp(token, "elif") == 0 ||
+         strcmp(token, "else") == 0 || strcmp(token, "fi") == 0 ||
+         strcmp(token, "do") == 0 || strcmp(token, "done") == 0;
+}
+
+// to count how many if/while/for blocks a line opens but does not close;
+// keywords only count at the start of a command, so `echo fi` is harmless
+int blockDepth(char* tokens[], int token_count) {
+  int depth = 0;
+  bool commandStart = true;
+  for (int i = 0; i < token_count; i++) {
+    if (strcmp(tokens[i], ";") == 0) {
+      commandStart = true;
+      continue;
+    }
+    if (commandStart) {
+      if (strcmp(tokens[i], "if") == 0 || strcmp(tokens[i], "while") == 0 ||
+          strcmp(tokens[i], "for") == 0) {
+        depth++;
+      } else if (strcmp(tokens[i], "fi") == 0 ||
+                 strcmp(tokens[i], "done") == 0) {
+        depth--;
+      }
+      commandStart = isCommandStartKeyword(tokens[i]);
+    }
+  }
+  return depth;
+}
+
+// to append tokens to a growing token array kept in an arena
+void appendTokens(Arena* arena,
+                  char*** tokens,
+                  int* token_count,
+                  int* capacity,
+                  char* extra[],
+                  int extra_count) {
+  if (*token_count + extra_count > *capacity) {
+    while (*token_count + extra_count > *capacity) {
+      *capacity *= 2;
+    }
+    char** grown = (char**)arenaAlloc(arena, (*capacity) * sizeof(char*));
+    memcpy(grown, *tokens, (*token_count) * sizeof(char*));
+    *tokens = grown;
+  }
+  for (int i = 0; i < extra_count; i++) {
+    (*tokens)[(*token_count)++] = extra[i];
+  }
+}
+
+// to read the tokens of one line, or of as many lines as it takes to close
+// every block the first one opens; lines are joined with a ";" token. Returns
+// false at the end of the input. The tokens are allocated from the arena
+bool readBlock(LineReader* reader,
+               Arena* arena,
+               char*** tokens,
+               int* token_count,
+               bool prompt) {
+  // every character of a line can at most become one token
+  char* line[MAX_INPUT_LENGTH];
+  int line_count = 0;
+  if (!readNextLine(reader, arena, line, &line_count)) {
+    return false;
+  }
+
+  int capacity = MAX_TOKENS;
+  *tokens = (char**)arenaAlloc(arena, capacity * sizeof(char*));
+  *token_count = 0;
+  appendTokens(arena, tokens, token_count, &capacity, line, line_count);
+
+  // every line starts a new command, so the depth of each line adds up
+  int depth = blockDepth(line, line_count);
+  while (depth > 0) {
+    if (prompt && isatty(STDIN_FILENO)) {
+      printf("> ");
+      fflush(stdout);
+    }
+    // an unterminated block is left for the compiler to report
+    if (!readNextLine(reader, arena, line, &line_count)) {
+      break;
+    }
+    char* separator = arenaStrdup(arena, ";");
+    appendTokens(arena, tokens, token_count, &capacity, &separator, 1);
+    appendTokens(arena, tokens, token_count, &capacity, line, line_count);
+    depth += blockDepth(line, line_count);
+  }
+  return true;
+}
+
+// to find the executable a command name runs by searching the PATH, so a
+// loop body does not repeat the search on every iteration; returns NULL when
+// there is none
+char* resolveCommandPath(Arena* arena, char* name) {
+  if (strchr(name, '/') != NULL) {
+    return access(name, X_OK) == 0 ? name : NULL;
+  }
+  char* path = getenv("PATH");
+  if (path == NULL) {
+    return NULL;
+  }
+  char candidate[PATH_MAX];
+  char* start = path;
+  while (1) {
+    char* end = strchr(start, ':');
+    int directoryLength = end != NULL ? (int)(end - start) : (int)strlen(start);
+    if (directoryLength == 0) {
+      // an empty PATH entry stands for the current directory
+      snprintf(candidate, sizeof(candidate), "%s", name);
+    } else {
+      snprintf(candidate, sizeof(candidate), "%.*s/%s", directoryLength, start,
+               name);
+    }
+    struct stat info;
+    if (stat(candidate, &info) == 0 && S_ISREG(info.st_mode) &&
+        access(candidate, X_OK) == 0) {
+      return arenaStrdup(arena, candidate);
+    }
+    if (end == NULL) {
+      return NULL;
+    }
+    start = end + 1;
+  }
+}
+
+// to grow one of the program's arrays so it has room for one more element;
+// the old copy stays in the arena until the arena is reset
+void* growArray(Arena* arena,
+                void* array,
+                int count,
+                int* capacity,
+                size_t elementSize) {
+  if (count < *capacity) {
+    return array;
+  }
+  *capacity = *capacity == 0 ? 16 : *capacity * 2;
+  void* grown = arenaAlloc(arena, (*capacity) * elementSize);
+  if (count > 0) {
+    memcpy(grown, array, count * elementSize);
+  }
+  return grown;
+}
+
+// to append an instruction and return its index
+int emit(Program* program, OpCode op, int operand, int target) {
+  program->code = (Instruction*)growArray(
+      program->arena, program->code, program->length, &program->capacity,
+      sizeof(Instruction));
+  Instruction* instruction = &program->code[program->length];
+  instruction->op = op;
+  instruction->operand = operand;
+  instruction->target = target;
+  return program->length++;
+}
+
+// to report the first syntax error of a program
+void syntaxError(Parser* parser, char* message, char* token) {
+  if (!parser->failed) {
+    fprintf(stderr, "syntax error: %s '%s'\n", message, token);
+  }
+  parser->failed = true;
+}
+
+// to check whether the parser is at a given word
+bool atWord(Parser* parser, char* word) {
+  Program* program = parser->program;
+  return parser->pos < program->tokenCount &&
+         strcmp(program->tokens[parser->pos], word) == 0;
+}
+
+// to step over any ; separators
+void skipSeparators(Parser* parser) {
+  while (atWord(parser, ";")) {
+    parser->pos++;
+  }
+}
+
+// to step over a required keyword, reporting an error if it is missing
+void expectWord(Parser* parser, char* word) {
+  skipSeparators(parser);
+  if (!atWord(parser, word)) {
+    syntaxError(parser, "expected", word);
+    return;
+  }
+  parser->pos++;
+}
+
+// to check whether a token is one of the words in a NULL terminated list
+bool isStopWord(char* token, char* stops[]) {
+  for (int i = 0; stops != NULL && stops[i] != NULL; i++) {
+    if (strcmp(token, stops[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// to get the keyword that closes a list of stop words
+char* lastStopWord(char* stops[]) {
+  int last = 0;
+  while (stops[last + 1] != NULL) {
+    last++;
+  }
+  return stops[last];
+}
+
+// to get the slot of a variable, or -1 if no loop has declared it
+int findVariable(Program* program, char* name) {
+  for (int i = 0; i < program->variableCount; i++) {
+    if (strcmp(program->variableNames[i], name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// to get the slot of a variable, adding it if it is new
+int declareVariable(Program* program, char* name) {
+  int existing = findVariable(program, name);
+  if (existing != -1) {
+    return existing;
+  }
+  int slot = program->variableCount;
+  int capacity = program->variableCapacity;
+  program->variableNames =
+      (char**)growArray(program->arena, program->variableNames, slot,
+                        &program->variableCapacity, sizeof(char*));
+  program->variableValues = (char**)growArray(
+      program->arena, program->variableValues, slot, &capacity, sizeof(char*));
+  program->variableNames[slot] = name;
+  program->variableValues[slot] = NULL;
+  return program->variableCount++;
+}
+
+// to get the variable slot a whole-token $name refers to, or -1 when the
+// token is a literal
+int variableReference(Program* program, char* token) {
+  if (token[0] != '$' || token[1] == '\0') {
+    return -1;
+  }
+  return findVariable(program, token + 1);
+}
+
+// to resolve the arguments of a span of tokens to variable slots; returns
+// whether any argument has to be filled in at run time
+bool resolveVariables(Program* program,
+                      char* words[],
+                      int count,
+                      int** variables) {
+  bool expands = false;
+  *variables = (int*)arenaAlloc(program->arena, count * sizeof(int));
+  for (int i = 0; i < count; i++) {
+    (*variables)[i] = variableReference(program, words[i]);
+    expands = expands || (*variables)[i] != -1;
+  }
+  return expands;
+}
+
+void compileList(Parser* parser, char* stops[]);
+
+// to compile a simple command, deciding once how it will run
+void compileSimple(Parser* parser) {
+  Program* program = parser->program;
+  int start = parser->pos;
+  while (parser->pos < program->tokenCount && !atWord(parser, ";")) {
+    parser->pos++;
+  }
+
+  program->commands = (CompiledCommand*)growArray(
+      program->arena, program->commands, program->commandCount,
+      &program->commandCapacity, sizeof(CompiledCommand));
+  CompiledCommand* command = &program->commands[program->commandCount++];
+  command->argc = parser->pos - start;
+  command->argv =
+      (char**)arenaAlloc(program->arena, (command->argc + 1) * sizeof(char*));
+  for (int i = 0; i < command->argc; i++) {
+    command->argv[i] = program->tokens[start + i];
+  }
+  command->argv[command->argc] = NULL;
+  command->expands = resolveVariables(program, command->argv, command->argc,
+                                      &command->variables);
+  command->path = NULL;
+
+  char* name = command->argv[0];
+  if (command->variables[0] != -1) {
+    command->kind = COMMAND_GENERAL;
+  } else if (strcmp(name, "set") == 0) {
+    command->kind = COMMAND_SET;
+  } else if (runsInShell(command->argv, command->argc)) {
+    command->kind = COMMAND_IN_SHELL;
+  } else if (!isShellBuiltin(name) &&
+             findStringInArray("|", command->argv, command->argc) == -1 &&
+             findStringInArray("<", command->argv, command->argc) == -1 &&
+             findStringInArray(">", command->argv, command->argc) == -1 &&
+             (command->path = resolveCommandPath(program->arena, name)) !=
+                 NULL) {
+    command->kind = COMMAND_EXTERNAL;
+  } else {
+    // builtins, pipes and redirections, and names not on the PATH, which
+    // executeCommand reports
+    command->kind = COMMAND_GENERAL;
+  }
+
+  emit(program, OP_RUN, program->commandCount - 1, -1);
+}
+
+// to compile `if list; then list; [elif list; then list;]... [else list;] fi`,
+// with the parser at the `if` or `elif`
+void compileIf(Parser* parser) {
+  Program* program = parser->program;
+  parser->pos++;
+  int start = program->length;
+  compileList(parser, conditionStops);
+  if (program->length == start) {
+    syntaxError(parser, "expected a condition before", "then");
+  }
+  expectWord(parser, "then");
+  int jumpElse = emit(program, OP_JUMP_IF_FAILURE, 0, -1);
+  compileList(parser, branchStops);
+  int jumpEnd = emit(program, OP_JUMP, 0, -1);
+  program->code[jumpElse].target = program->length;
+  if (atWord(parser, "elif")) {
+    // an elif is an if nested in the else branch, and it takes the fi
+    compileIf(parser);
+  } else if (atWord(parser, "else")) {
+    parser->pos++;
+    compileList(parser, elseStops);
+    expectWord(parser, "fi");
+  } else {
+    // an if without a taken branch succeeds
+    emit(program, OP_SET_STATUS, 0, -1);
+    expectWord(parser, "fi");
+  }
+  program->code[jumpEnd].target = program->length;
+}
+
+// to compile `while list; do list; done`; the loop's status is that of the
+// last body command, kept in a saved status slot across the condition
+void compileWhile(Parser* parser) {
+  Program* program = parser->program;
+  parser->pos++;
+  int saved = program->savedCount++;
+  emit(program, OP_SET_STATUS, 0, -1);
+  emit(program, OP_SAVE_STATUS, saved, -1);
+  int top = program->length;
+  compileList(parser, loopConditionStops);
+  if (program->length == top) {
+    syntaxError(parser, "expected a condition before", "do");
+  }
+  expectWord(parser, "do");
+  int jumpEnd = emit(program, OP_JUMP_IF_FAILURE, 0, -1);
+  compileList(parser, bodyStops);
+  expectWord(parser, "done");
+  emit(program, OP_SAVE_STATUS, saved, -1);
+  emit(program, OP_JUMP, 0, top);
+  program->code[jumpEnd].target = program->length;
+  emit(program, OP_LOAD_STATUS, saved, -1);
+}
+
+// to compile `for name [in word...]; do list; done`
+void compileFor(Parser* parser) {
+  Program* program = parser->program;
+  parser->pos++;
+  if (parser->pos >= program->tokenCount || atWord(parser, ";") ||
+      isReservedWord(program->tokens[parser->pos])) {
+    syntaxError(parser, "expected a variable name after", "for");
+    return;
+  }
+  char* name = program->tokens[parser->pos++];
+
+  program->loops = (ForLoop*)growArray(program->arena, program->loops,
+                                       program->loopCount,
+                                       &program->loopCapacity, sizeof(ForLoop));
+  int loopIndex = program->loopCount++;
+  ForLoop* loop = &program->loops[loopIndex];
+  loop->words = NULL;
+  loop->wordCount = 0;
+  loop->next = 0;
+  if (atWord(parser, "in")) {
+    parser->pos++;
+    int start = parser->pos;
+    while (parser->pos < program->tokenCount && !atWord(parser, ";")) {
+      parser->pos++;
+    }
+    loop->words = &program->tokens[start];
+    loop->wordCount = parser->pos - start;
+  }
+  // words are resolved before the loop's own variable is declared, so
+  // `for x in $x` walks the outer value
+  resolveVariables(program, loop->words, loop->wordCount,
+                   &loop->wordVariables);
+  loop->variable = declareVariable(program, name);
+
+  expectWord(parser, "do");
+  emit(program, OP_SET_STATUS, 0, -1);
+  emit(program, OP_FOR_START, loopIndex, -1);
+  int top = emit(program, OP_FOR_NEXT, loopIndex, -1);
+  compileList(parser, bodyStops);
+  expectWord(parser, "done");
+  emit(program, OP_JUMP, 0, top);
+  program->code[top].target = program->length;
+}
+
+// to compile commands and blocks until one of the stop words, or the end of
+// the tokens when stops is NULL
+void compileList(Parser* parser, char* stops[]) {
+  Program* program = parser->program;
+  while (!parser->failed) {
+    skipSeparators(parser);
+    if (parser->pos >= program->tokenCount) {
+      return;
+    }
+    char* token = program->tokens[parser->pos];
+    if (isStopWord(token, stops)) {
+      return;
+    }
+    if (strcmp(token, "if") == 0) {
+      compileIf(parser);
+    } else if (strcmp(token, "while") == 0) {
+      compileWhile(parser);
+    } else if (strcmp(token, "for") == 0) {
+      compileFor(parser);
+    } else if (isReservedWord(token) && stops != NULL) {
+      // a keyword of an enclosing block, e.g. the fi of `if true echo; fi`,
+      // means this block's own keyword never came
+      syntaxError(parser, "expected", lastStopWord(stops));
+    } else if (isReservedWord(token)) {
+      syntaxError(parser, "unexpected", token);
+    } else {
+      compileSimple(parser);
+    }
+  }
+}
+
+// to compile the tokens of a command line into a program allocated from the
+// same arena as the tokens; returns NULL after reporting a syntax error. The
+// program lives until the arena is reset
+Program* compileProgram(Arena* arena, char** tokens, int token_count) {
+  Program* program = (Program*)arenaAlloc(arena, sizeof(Program));
+  memset(program, 0, sizeof(Program));
+  program->arena = arena;
+  program->tokens = tokens;
+  program->tokenCount = token_count;
+
+  Parser parser = {program, 0, false};
+  compileList(&parser, NULL);
+  if (parser.failed) {
+    return NULL;
+  }
+  program->savedStatuses =
+      (int*)arenaAlloc(arena, program->savedCount * sizeof(int));
+  return program;
+}
+
+// to fork and exec a program from its resolved path and return its status
+int runExternalCommand(char* path, char* argv[]) {
+  fflush(stdout);
+  pid_t child_pid = fork();
+  if (child_pid == -1) {
+    perror("Fork failed");
+    return 1;
+  }
+  if (child_pid == 0) {
+    execv(path, argv);
+    char error_message[100];
+    snprintf(error_message, sizeof(error_message), "[%s]: command not found",
+             argv[0]);
+    perror(error_message);
+    exitChild(EXIT_FAILURE);
+  }
+  int status;
+  waitpid(child_pid, &status, 0);
+  return decodeStatus(status);
+}
+
+// to fill in the loop variables of a command and run it the way it was
+// compiled to
+int runCompiledCommand(Program* program, CompiledCommand* command) {
+  if (command->expands) {
+    for (int i = 0; i < command->argc; i++) {
+      if (command->variables[i] != -1) {
+        char* value = program->variableValues[command->variables[i]];
+        command->argv[i] = value != NULL ? value : "";
+      }
+    }
+  }
+  switch (command->kind) {
+    case COMMAND_IN_SHELL:
+      return executeBuiltinInShell(command->argv, command->argc);
+    case COMMAND_SET:
+      return executeSetCommand(command->argv, command->argc);
+    case COMMAND_EXTERNAL:
+      return runExternalCommand(command->path, command->argv);
+    default:
+      return executeCommand(command->argv, command->argc);
+  }
+}
+
+// to interpret a program and return the exit status of its last command
+int runProgram(Program* program) {
+  int status = 0;
+  int pc = 0;
+  while (pc < program->length) {
+    Instruction* instruction = &program->code[pc++];
+    switch (instruction->op) {
+      case OP_RUN:
+        status = runCompiledCommand(
+            program, &program->commands[instruction->operand]);
+        break;
+      case OP_JUMP:
+        pc = instruction->target;
+        break;
+      case OP_JUMP_IF_FAILURE:
+        if (status != 0) {
+          pc = instruction->target;
+        }
+        break;
+      case OP_FOR_START:
+        program->loops[instruction->operand].next = 0;
+        break;
+      case OP_FOR_NEXT: {
+        ForLoop* loop = &program->loops[instruction->operand];
+        if (loop->next >= loop->wordCount) {
+          pc = instruction->target;
+          break;
+        }
+        int reference = loop->wordVariables[loop->next];
+        char* word = reference != -1 ? program->variableValues[reference]
+                                     : loop->words[loop->next];
+        program->variableValues[loop->variable] = word;
+        loop->next++;
+        break;
+      }
+      case OP_SET_STATUS:
+        status = instruction->operand;
+        break;
+      case OP_SAVE_STATUS:
+        program->savedStatuses[instruction->operand] = status;
+        break;
+      case OP_LOAD_STATUS:
+        status = program->savedStatuses[instruction->operand];
+        break;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,100 @@
+#include <stdbool.h>
+#include "readahead.h"
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+// the instructions a command line is compiled into; jumps hold the index of
+// the instruction to continue at
+typedef enum {
+  OP_RUN,              // run commands[operand] and keep its exit status
+  OP_JUMP,             // continue at target
+  OP_JUMP_IF_FAILURE,  // continue at target when the last status is not 0
+  OP_FOR_START,        // rewind loops[operand] to its first word
+  OP_FOR_NEXT,         // bind the next word of loops[operand] or go to target
+  OP_SET_STATUS,       // make operand the last status
+  OP_SAVE_STATUS,      // copy the last status into savedStatuses[operand]
+  OP_LOAD_STATUS       // make savedStatuses[operand] the last status
+} OpCode;
+
+typedef struct {
+  OpCode op;
+  int operand;
+  int target;
+} Instruction;
+
+// how a compiled command runs, decided once when it is compiled
+typedef enum {
+  COMMAND_IN_SHELL,  // fork-free builtin run by executeBuiltinInShell
+  COMMAND_SET,       // the set builtin
+  COMMAND_EXTERNAL,  // plain program, exec'd straight from its resolved path
+  COMMAND_GENERAL    // anything else, handed to executeCommand
+} CommandKind;
+
+// a simple command; argv points at the program's tokens and is NULL
+// terminated, and arguments that name a loop variable are filled in on
+// every run
+typedef struct {
+  CommandKind kind;
+  char** argv;
+  int argc;
+  int* variables;  // variable slot of each argument, or -1 for a literal
+  bool expands;
+  char* path;  // resolved executable for COMMAND_EXTERNAL
+} CompiledCommand;
+
+// the words a for loop walks through and the variable they are bound to
+typedef struct {
+  int variable;
+  char** words;
+  int* wordVariables;
+  int wordCount;
+  int next;
+} ForLoop;
+
+// a compiled command line; it and everything it points to is allocated from
+// the arena of the line it was read from
+typedef struct {
+  Arena* arena;
+  char** tokens;
+  int tokenCount;
+  Instruction* code;
+  int length;
+  int capacity;
+  CompiledCommand* commands;
+  int commandCount;
+  int commandCapacity;
+  ForLoop* loops;
+  int loopCount;
+  int loopCapacity;
+  char** variableNames;
+  char** variableValues;
+  int variableCount;
+  int variableCapacity;
+  int* savedStatuses;
+  int savedCount;
+} Program;
+
+typedef struct {
+  Program* program;
+  int pos;
+  bool failed;
+} Parser;
+
+bool isCommandStartKeyword(char* token);
+
+int blockDepth(char* tokens[], int token_count);
+
+bool readBlock(LineReader* reader,
+               Arena* arena,
+               char*** tokens,
+               int* token_count,
+               bool prompt);
+
+char* resolveCommandPath(Arena* arena, char* name);
+
+Program* compileProgram(Arena* arena, char** tokens, int token_count);
+
+int runProgram(Program* program);
+
+#endif
@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include "readahead.h"
+
+// to decide whether lines of a file should be parsed ahead on a thread; only
+// non-interactive input is, and MINISHELL_READAHEAD=0 turns it off
+bool useReadahead(FILE* file) {
+  char* setting = getenv("MINISHELL_READAHEAD");
+  if (setting != NULL && strcmp(setting, "0") == 0) {
+    return false;
+  }
+  return !isatty(fileno(file));
+}
+
+// to read and tokenize a single line into an arena, returning false at the
+// end of the file
+bool parseLine(FILE* file, Arena* arena, char* tokens[], int* token_count) {
+  char input[MAX_INPUT_LENGTH];
+  *token_count = 0;
+  if (fgets(input, MAX_INPUT_LENGTH, file) == NULL) {
+    return false;
+  }
+  tokenizeKinds(arena, input, tokens, NULL, token_count);
+  return true;
+}
+
+// to wait until the ring has a free slot; once it is full the reader sleeps
+// until the executor has emptied half of it, so that the two threads do not
+// wake each other for every line
+void waitForFreeSlot(LineReader* reader, size_t tail) {
+  if (tail - atomic_load_explicit(&reader->head, memory_order_acquire) <
+      READAHEAD_QUEUE_SIZE) {
+    return;
+  }
+  pthread_mutex_lock(&reader->lock);
+  // the flag is raised before head is checked again and releaseSlot stores
+  // head before checking the flag, so one of them sees the other
+  atomic_store(&reader->readerWaiting, true);
+  while (tail - atomic_load(&reader->head) > READAHEAD_QUEUE_SIZE / 2 &&
+         !atomic_load(&reader->stop)) {
+    pthread_cond_wait(&reader->notFull, &reader->lock);
+  }
+  atomic_store(&reader->readerWaiting, false);
+  pthread_mutex_unlock(&reader->lock);
+}
+
+// to publish the slot before tail, waking the executor if it sleeps
+void publishLine(LineReader* reader, size_t tail) {
+  atomic_store(&reader->tail, tail);
+  if (atomic_load(&reader->executorWaiting)) {
+    pthread_mutex_lock(&reader->lock);
+    pthread_cond_signal(&reader->notEmpty);
+    pthread_mutex_unlock(&reader->lock);
+  }
+}
+
+// to wait until the reader has published the slot at head
+void waitForLine(LineReader* reader, size_t head) {
+  if (atomic_load_explicit(&reader->tail, memory_order_acquire) != head) {
+    return;
+  }
+  pthread_mutex_lock(&reader->lock);
+  atomic_store(&reader->executorWaiting, true);
+  while (atomic_load(&reader->tail) == head) {
+    pthread_cond_wait(&reader->notEmpty, &reader->lock);
+  }
+  atomic_store(&reader->executorWaiting, false);
+  pthread_mutex_unlock(&reader->lock);
+}
+
+// to hand the slots before head back to the reader, waking it once half the
+// ring is free
+void releaseSlot(LineReader* reader, size_t head) {
+  atomic_store(&reader->head, head);
+  if (atomic_load(&reader->readerWaiting) &&
+      atomic_load_explicit(&reader->tail, memory_order_relaxed) - head <=
+          READAHEAD_QUEUE_SIZE / 2) {
+    pthread_mutex_lock(&reader->lock);
+    pthread_cond_signal(&reader->notFull);
+    pthread_mutex_unlock(&reader->lock);
+  }
+}
+
+// the producer: parse lines into free slots of the ring until the file ends,
+// then publish an end-of-file slot; it can only be cancelled while reading,
+// so it never goes away holding the ring's lock
+void* readerThread(void* arg) {
+  LineReader* reader = (LineReader*)arg;
+  size_t tail = atomic_load_explicit(&reader->tail, memory_order_relaxed);
+  bool eof = false;
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+  while (!eof) {
+    // wait for the executor to free a slot
+    waitForFreeSlot(reader, tail);
+    if (atomic_load(&reader->stop)) {
+      break;
+    }
+    ParsedLine* slot = &reader->slots[tail % READAHEAD_QUEUE_SIZE];
+    // the executor took the blocks of the slot's last line before freeing it
+    arenaReset(&slot->arena);
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    eof = !parseLine(reader->file, &slot->arena, slot->tokens,
+                     &slot->token_count);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    slot->eof = eof;
+    tail++;
+    publishLine(reader, tail);
+  }
+  return NULL;
+}
+
+// to prepare a reader for a file, starting the producer thread if threaded
+void startLineReader(LineReader* reader, FILE* file, bool threaded) {
+  reader->file = file;
+  reader->threaded = threaded;
+  atomic_init(&reader->stop, false);
+  atomic_init(&reader->head, 0);
+  atomic_init(&reader->tail, 0);
+  atomic_init(&reader->readerWaiting, false);
+  atomic_init(&reader->executorWaiting, false);
+  if (threaded) {
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->notFull, NULL);
+    pthread_cond_init(&reader->notEmpty, NULL);
+    for (int i = 0; i < READAHEAD_QUEUE_SIZE; i++) {
+      arenaInit(&reader->slots[i].arena, MAX_INPUT_LENGTH * 2);
+    }
+  }
+  if (threaded &&
+      pthread_create(&reader->thread, NULL, readerThread, reader) != 0) {
+    perror("pthread_create");
+    reader->threaded = false;
+  }
+}
+
+// to get the tokens of the next line, allocated from the given arena,
+// returning false at the end of the file
+bool readNextLine(LineReader* reader,
+                  Arena* arena,
+                  char* tokens[],
+                  int* token_count) {
+  if (!reader->threaded) {
+    return parseLine(reader->file, arena, tokens, token_count);
+  }
+
+  size_t head = atomic_load_explicit(&reader->head, memory_order_relaxed);
+  // wait for the reader thread to publish a slot
+  waitForLine(reader, head);
+  ParsedLine* slot = &reader->slots[head % READAHEAD_QUEUE_SIZE];
+  if (slot->eof) {
+    // leave the end-of-file slot in place so later calls see it too
+    *token_count = 0;
+    return false;
+  }
+  *token_count = slot->token_count;
+  memcpy(tokens, slot->tokens, slot->token_count * sizeof(char*));
+  // the line's blocks join the caller's arena rather than being copied
+  arenaAdopt(arena, &slot->arena);
+  releaseSlot(reader, head + 1);
+  return true;
+}
+
+// to stop the reader thread, dropping any lines it parsed ahead of time; the
+// thread is woken if it waits for a free slot and cancelled if it waits for
+// input, so stopping does not wait for the rest of the file
+void stopLineReader(LineReader* reader) {
+  if (!reader->threaded) {
+    return;
+  }
+  pthread_mutex_lock(&reader->lock);
+  atomic_store(&reader->stop, true);
+  pthread_cond_signal(&reader->notFull);
+  pthread_mutex_unlock(&reader->lock);
+  pthread_cancel(reader->thread);
+  // the slots are only freed once the thread can no longer touch them
+  pthread_join(reader->thread, NULL);
+  for (int i = 0; i < READAHEAD_QUEUE_SIZE; i++) {
+    arenaFree(&reader->slots[i].arena);
+  }
+  pthread_mutex_destroy(&reader->lock);
+  pthread_cond_destroy(&reader->notFull);
+  pthread_cond_destroy(&reader->notEmpty);
+  reader->threaded = false;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "tokens.h"
+// number of parsed lines the reader thread may get ahead of the executor
+#define READAHEAD_QUEUE_SIZE 256
+
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+// one tokenized input line as handed from the reader thread to the executor;
+// the tokens live in the slot's arena until readNextLine hands its blocks on
+typedef struct {
+  Arena arena;
+  // every character of a line can at most become one token
+  char* tokens[MAX_INPUT_LENGTH];
+  int token_count;
+  bool eof;
+} ParsedLine;
+
+// reads and tokenizes lines of a file, either inline on each call or ahead of
+// time on a producer thread feeding a single-producer single-consumer ring;
+// a side that finds the ring full or empty sleeps on a condition variable
+// until the other side has moved on
+typedef struct {
+  FILE* file;
+  bool threaded;
+  pthread_t thread;
+  atomic_bool stop;
+  atomic_size_t head;  // next slot the executor takes, owned by the consumer
+  atomic_size_t tail;  // next slot the reader fills, owned by the producer
+  pthread_mutex_t lock;
+  pthread_cond_t notFull;   // signalled when head moves
+  pthread_cond_t notEmpty;  // signalled when tail moves
+  atomic_bool readerWaiting;
+  atomic_bool executorWaiting;
+  ParsedLine slots[READAHEAD_QUEUE_SIZE];
+} LineReader;
+
+bool useReadahead(FILE* file);
+
+bool parseLine(FILE* file, Arena* arena, char* tokens[], int* token_count);
+
+void waitForFreeSlot(LineReader* reader, size_t tail);
+
+void publishLine(LineReader* reader, size_t tail);
+
+void waitForLine(LineReader* reader, size_t head);
+
+void releaseSlot(LineReader* reader, size_t head);
+
+void* readerThread(void* arg);
+
+void startLineReader(LineReader* reader, FILE* file, bool threaded);
+
+bool readNextLine(LineReader* reader,
+                  Arena* arena,
+                  char* tokens[],
+                  int* token_count);
+
+void stopLineReader(LineReader* reader);
+
+#endif
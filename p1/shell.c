@@ -1,8 +1,20 @@
 #include "shell.h"
 #include "tokens.h"
+#include "readahead.h"
+#include "bytecode.h"
+
+extern char** environ;
 
 int pipe_fds[2];
 
+// the arena that per-line data such as argv arrays are allocated from; it is
+// reset when the line is done
+Arena* line_arena = NULL;
+
+// capacity applied to every pipeline pipe with F_SETPIPE_SZ, 0 keeps the
+// kernel default; changed with `set pipesize=...`
+long pipe_size = 0;
+
 // to execute a pipe command
 int executePipeCommand(char* leftCommand[],
                        int leftCommandLength,
@@ -11,33 +23,34 @@ int executePipeCommand(char* leftCommand[],
   int pipe_fds[2];  // the pipe system call creates two file descriptors in the
                     // 2-element array given as argument
 
-  pipe(pipe_fds);  // returns 0 on success
+  if (pipe(pipe_fds) == -1) {  // returns 0 on success
+    perror("pipe");
+    return 1;
+  }
 
   int read_fd = pipe_fds[0];   // index 0 is the "read end" of the pipe
   int write_fd = pipe_fds[1];  // index 1 is the "write end" of the pipt
 
+  if (pipe_size > 0 && fcntl(write_fd, F_SETPIPE_SZ, (int)pipe_size) == -1) {
+    perror("F_SETPIPE_SZ");
+  }
+
   pid_t childA_pid = fork();
 
   if (childA_pid == 0) {  // in child A
     close(read_fd);       // close the other end of the pipe
 
     // replace stdout with the write end of the pipe
-    if (close(1) == -1) {
-      perror("Error closing stdout");
-      exit(1);
+    if (dup2(write_fd, STDOUT_FILENO) == -1) {
+      perror("Error replacing stdout");
+      exitChild(1);
     }
+    close(write_fd);
 
-    dup(write_fd);
-    executeCommand(leftCommand, leftCommandLength);
-      
-    // exit(0);
+    exitChild(executeCommand(leftCommand, leftCommandLength));
   } else if (childA_pid == -1) {
     perror("Error - fork failed A");
-    exit(1);
-  } else {
-    close(write_fd);
-    int A_status;
-    waitpid(childA_pid, &A_status, WNOHANG);
+    exitChild(1);
   }
 
   pid_t childB_pid = fork();
@@ -45,60 +58,42 @@ int executePipeCommand(char* leftCommand[],
     close(write_fd);      // close the other end of the pipe
 
     // replace stdin with the read end of the pipe
-    if (close(0) == -1) {
-      perror("Error closing stdin");
-      exit(1);
+    if (dup2(read_fd, STDIN_FILENO) == -1) {
+      perror("Error replacing stdin");
+      exitChild(1);
     }
-    dup(read_fd);
+    close(read_fd);
 
-    exit(0);
+    // the right side may itself contain further pipes
+    exitChild(executeCommand(rightCommand, rightCommandLength));
   } else if (childB_pid == -1) {
     perror("Error - fork failed B");
-    exit(1);
-  } else {
-    close(read_fd);
-    int B_status;
-    waitpid(childB_pid, &B_status, WNOHANG);
+    exitChild(1);
   }
+
+  // both ends have to be closed here, otherwise child B never sees EOF
   close(write_fd);
   close(read_fd);
 
-  return 0;
+  int A_status;
+  int B_status;
+  waitpid(childA_pid, &A_status, 0);
+  waitpid(childB_pid, &B_status, 0);
+
+  return decodeStatus(B_status);
 }
 
-// to add a null terminator at the end of an array of command and its arguments
+// to add a null terminator at the end of an array of command and its
+// arguments; the new array is allocated from the line arena and points at the
+// same strings, which are not copied
 char** addNullTerminator(char* array[], int size) {
-  char** newArray = (char**)malloc((size + 1) * sizeof(char*));
-  if (newArray == NULL) {
-    fprintf(stderr, "Memory allocation failed.\n");
-    exit(EXIT_FAILURE);
-  }
-
-  for (int i = 0; i < size; i++) {
-    newArray[i] = (char*)malloc(strlen(array[i]) + 1);
-    if (newArray[i] == NULL) {
-      fprintf(stderr, "Memory allocation failed.\n");
-      exit(EXIT_FAILURE);
-    }
-    strcpy(newArray[i], array[i]);
-  }
-
+  char** newArray = (char**)arenaAlloc(line_arena, (size + 1) * sizeof(char*));
+  memcpy(newArray, array, size * sizeof(char*));
   newArray[size] = NULL;
 
   return newArray;
 }
 
-// to free the memory taken up by a string array
-void freeStringArray(char** array) {
-  if (array == NULL) {
-    return;
-  }
-  for (int i = 0; array[i] != NULL; i++) {
-    free(array[i]);
-  }
-  free(array);
-}
-
 // to execute a simple command
 void executeSimpleCommand(char* command[], int command_length) {
   char** nullTerminatedCommand = addNullTerminator(command, command_length);
@@ -115,51 +110,58 @@ void executeSimpleCommand(char* command[], int command_length) {
     printf(
         "5. help   : explains all the built-in commands available in the "
         "shell\n");
+    printf(
+        "6. echo, printf, pwd, true, false, test, cat : run inside the shell "
+        "without starting a new process\n");
+    printf(
+        "7. set    : sets a shell option, e.g. set pipesize=1M for the "
+        "capacity of pipeline pipes\n");
+    printf(
+        "8. batch  : runs a command over the lines of stdin (or -a file), "
+        "packing as many as fit into each argument list\n");
+    printf(
+        "Control flow: if cmd; then ...; [elif ...; then ...;] [else ...;] "
+        "fi, while cmd; do ...; done and for x in words; do ... $x ...; "
+        "done\n");
   } else if (strcmp(nullTerminatedCommand[0], "prev") == 0) {
     // status_code = 2;
     // use_prev = true;
     // status_char = 'p';
   } else if (strcmp(nullTerminatedCommand[0], "source") == 0) {
     FILE* file;
-    char line[MAX_INPUT_LENGTH];
     char* filename = nullTerminatedCommand[1];
     file = fopen(filename, "r");
     if (file == NULL) {
       perror("File open failed");
-      // return 1;
-    }
-    while (fgets(line, sizeof(line), file) != NULL) {
-      char* tokens[MAX_TOKENS];
-      int token_count = 0;
-      int semicolonCount = 0;
-      tokenize(line, tokens, &token_count);
-      int* semicolonIndices =
-          findSemicolonIndices(tokens, token_count, &semicolonCount);
-      int startIdx = 0;
-      int endIdx = semicolonIndices[0];
-      char** currentCommand = NULL;
-      int commandLength = 0;
-      for (int i = 0; i < semicolonCount; i++) {
-        getCurrentCommand(tokens, startIdx, endIdx, &commandLength,
-                          &currentCommand);
-        executeCommand(currentCommand, commandLength);
-
-        if ((i + 1) != semicolonCount) {
-          startIdx = semicolonIndices[i] + 1;
-          endIdx = semicolonIndices[i + 1];
-        }
-
-        for (int i = 0; i < commandLength; i++) {
-          free(currentCommand[i]);
-        }
-      }
-      free(currentCommand);
-      free(semicolonIndices);
-      for (int i = 0; i < token_count; i++) {
-        free(tokens[i]);
+      exitChild(EXIT_FAILURE);
+    }
+    // lines are parsed ahead on a reader thread while earlier ones execute
+    LineReader reader;
+    startLineReader(&reader, file, useReadahead(file));
+    // each line of the script gets the arena to itself and resets it after
+    Arena arena;
+    arenaInit(&arena, ARENA_BLOCK_SIZE);
+    Arena* outer_arena = line_arena;
+    line_arena = &arena;
+    char** tokens;
+    int token_count = 0;
+    while (readBlock(&reader, &arena, &tokens, &token_count, false)) {
+      Program* program = compileProgram(&arena, tokens, token_count);
+      if (program != NULL) {
+        runProgram(program);
       }
+      arenaReset(&arena);
     }
+    line_arena = outer_arena;
+    arenaFree(&arena);
+    stopLineReader(&reader);
     fclose(file);
+  } else if (isForkFreeBuiltin(nullTerminatedCommand[0])) {
+    // only reached in a child, e.g. as a pipeline stage
+    exitChild(
+        runBuiltin(nullTerminatedCommand, command_length, STDIN_FILENO));
+  } else if (strcmp(nullTerminatedCommand[0], "batch") == 0) {
+    executeBatchCommand(nullTerminatedCommand, command_length);
   } else if (strcmp(nullTerminatedCommand[0], "cd") == 0) {
     // change the cd of this child
     chdir(nullTerminatedCommand[1]);
@@ -176,17 +178,658 @@ void executeSimpleCommand(char* command[], int command_length) {
     snprintf(error_message, sizeof(error_message), "[%s]: command not found",
              command[0]);
     perror(error_message);
-    exit(EXIT_FAILURE);
+    exitChild(EXIT_FAILURE);
   } else {
     // printf("Exited simple commdn\n");
     // status_char = 'c';
   }
-  freeStringArray(nullTerminatedCommand);
   // return status_char;
 }
 
-// to execute a redirection command
-void executeRedirCommand(char* command[],
+// to compute how many bytes of the exec argument space are left once the
+// environment and some headroom have been accounted for
+long getArgumentSpace() {
+  long argMax = sysconf(_SC_ARG_MAX);
+  if (argMax <= 0) {
+    argMax = BATCH_MIN_ARG_SPACE;
+  }
+  long envSize = 0;
+  for (int i = 0; environ[i] != NULL; i++) {
+    envSize += strlen(environ[i]) + 1 + sizeof(char*);
+  }
+  long space = argMax - envSize - BATCH_ARG_HEADROOM;
+  if (space < BATCH_MIN_ARG_SPACE) {
+    space = BATCH_MIN_ARG_SPACE;
+  }
+  return space;
+}
+
+// to fork a child that execs one batch, waiting for a free slot first when
+// maxJobs batches are already running
+void runBatch(char* args[], int argCount, int* running, int maxJobs,
+              bool* failed) {
+  int status;
+  while (*running >= maxJobs) {
+    if (wait(&status) == -1) {
+      break;
+    }
+    (*running)--;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      *failed = true;
+    }
+  }
+
+  pid_t child_pid = fork();
+  if (child_pid == 0) {
+    executeSimpleCommand(args, argCount);
+    exitChild(0);
+  } else if (child_pid == -1) {
+    perror("Fork failed");
+    *failed = true;
+  } else {
+    (*running)++;
+  }
+}
+
+// to run a command over every line of stdin (or of the -a file), packing as
+// many lines as fit into the argument list of each exec, like xargs
+void executeBatchCommand(char* command[], int command_length) {
+  int maxItems = 0;  // 0 means only the argument space limits a batch
+  int maxJobs = 1;
+  char* inputFile = NULL;
+  int cmdStart = 1;
+  while (cmdStart + 1 < command_length && command[cmdStart][0] == '-') {
+    if (strcmp(command[cmdStart], "-n") == 0) {
+      maxItems = atoi(command[cmdStart + 1]);
+    } else if (strcmp(command[cmdStart], "-P") == 0) {
+      maxJobs = atoi(command[cmdStart + 1]);
+    } else if (strcmp(command[cmdStart], "-a") == 0) {
+      inputFile = command[cmdStart + 1];
+    } else {
+      break;
+    }
+    cmdStart += 2;
+  }
+  if (cmdStart >= command_length || maxItems < 0 || maxJobs < 1) {
+    fprintf(stderr, "usage: batch [-n max] [-P jobs] [-a file] cmd [args]\n");
+    exitChild(EXIT_FAILURE);
+  }
+
+  // stdin is reopened rather than used directly because the FILE buffer
+  // inherited from the shell may still hold lines of the shell's own input
+  FILE* input;
+  if (inputFile != NULL) {
+    input = fopen(inputFile, "r");
+  } else {
+    input = fdopen(dup(STDIN_FILENO), "r");
+  }
+  if (input == NULL) {
+    perror("File open failed");
+    exitChild(EXIT_FAILURE);
+  }
+
+  // the fixed part of every argument list is the command and its own args
+  int baseCount = command_length - cmdStart;
+  long baseSize = 0;
+  for (int i = cmdStart; i < command_length; i++) {
+    baseSize += strlen(command[i]) + 1 + sizeof(char*);
+  }
+  long space = getArgumentSpace();
+
+  int capacity = baseCount + BATCH_INITIAL_ITEMS;
+  char** args = (char**)malloc(capacity * sizeof(char*));
+  if (args == NULL) {
+    fprintf(stderr, "Memory allocation failed.\n");
+    exitChild(EXIT_FAILURE);
+  }
+  for (int i = 0; i < baseCount; i++) {
+    args[i] = command[cmdStart + i];
+  }
+  int argCount = baseCount;
+  long used = baseSize;
+
+  int running = 0;
+  bool failed = false;
+  char* line = NULL;
+  size_t lineCapacity = 0;
+  ssize_t lineLength;
+  while ((lineLength = getline(&line, &lineCapacity, input)) != -1) {
+    while (lineLength > 0 &&
+           (line[lineLength - 1] == '\n' || line[lineLength - 1] == '\r')) {
+      line[--lineLength] = '\0';
+    }
+    if (lineLength == 0) {
+      continue;
+    }
+    long cost = lineLength + 1 + sizeof(char*);
+    int items = argCount - baseCount;
+    if (items > 0 &&
+        (used + cost > space || (maxItems > 0 && items >= maxItems))) {
+      runBatch(args, argCount, &running, maxJobs, &failed);
+      for (int i = baseCount; i < argCount; i++) {
+        free(args[i]);
+      }
+      argCount = baseCount;
+      used = baseSize;
+    }
+    if (argCount == capacity) {
+      capacity *= 2;
+      args = (char**)realloc(args, capacity * sizeof(char*));
+      if (args == NULL) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exitChild(EXIT_FAILURE);
+      }
+    }
+    args[argCount++] = my_strdup(line);
+    used += cost;
+  }
+  if (argCount > baseCount) {
+    runBatch(args, argCount, &running, maxJobs, &failed);
+    for (int i = baseCount; i < argCount; i++) {
+      free(args[i]);
+    }
+  }
+
+  int status;
+  while (running > 0 && wait(&status) != -1) {
+    running--;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed = true;
+    }
+  }
+
+  free(line);
+  free(args);
+  fclose(input);
+  if (failed) {
+    exitChild(EXIT_FAILURE);
+  }
+}
+
+// to check whether a command is a builtin that can run without a fork
+bool isForkFreeBuiltin(char* name) {
+  return strcmp(name, "echo") == 0 || strcmp(name, "printf") == 0 ||
+         strcmp(name, "pwd") == 0 || strcmp(name, "true") == 0 ||
+         strcmp(name, "false") == 0 || strcmp(name, "test") == 0 ||
+         strcmp(name, "[") == 0 || strcmp(name, "cat") == 0;
+}
+
+// to check whether a name is handled by the shell rather than looked up on
+// the PATH
+bool isShellBuiltin(char* name) {
+  return isForkFreeBuiltin(name) || strcmp(name, "help") == 0 ||
+         strcmp(name, "prev") == 0 || strcmp(name, "source") == 0 ||
+         strcmp(name, "cd") == 0 || strcmp(name, "batch") == 0 ||
+         strcmp(name, "set") == 0 || strcmp(name, "exit") == 0;
+}
+
+// to write the arguments separated by spaces; -n drops the trailing newline
+int builtinEcho(char* argv[], int argc) {
+  int start = 1;
+  bool newline = true;
+  if (argc > 1 && strcmp(argv[1], "-n") == 0) {
+    newline = false;
+    start = 2;
+  }
+  for (int i = start; i < argc; i++) {
+    if (i > start) {
+      putchar(' ');
+    }
+    fputs(argv[i], stdout);
+  }
+  if (newline) {
+    putchar('\n');
+  }
+  return 0;
+}
+
+// to write the character a backslash escape in a printf format stands for,
+// returning how many characters of the format it used
+int printEscape(const char* escape) {
+  switch (escape[0]) {
+    case 'n':
+      putchar('\n');
+      return 1;
+    case 't':
+      putchar('\t');
+      return 1;
+    case 'r':
+      putchar('\r');
+      return 1;
+    case 'a':
+      putchar('\a');
+      return 1;
+    case '\\':
+      putchar('\\');
+      return 1;
+    case '\0':
+      putchar('\\');
+      return 0;
+    default:
+      putchar('\\');
+      putchar(escape[0]);
+      return 1;
+  }
+}
+
+// to format the arguments like printf(1): the format is reused while
+// arguments remain, and missing arguments read as "" or 0
+int builtinPrintf(char* argv[], int argc) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: printf format [arguments]\n");
+    return 2;
+  }
+  char* format = argv[1];
+  int next = 2;
+  do {
+    int first = next;
+    for (int i = 0; format[i] != '\0'; i++) {
+      if (format[i] == '\\') {
+        i += printEscape(&format[i + 1]);
+        continue;
+      }
+      if (format[i] != '%') {
+        putchar(format[i]);
+        continue;
+      }
+      if (format[i + 1] == '%') {
+        putchar('%');
+        i++;
+        continue;
+      }
+      // copy the flags, width and precision into a one-conversion format
+      char spec[32];
+      int length = 0;
+      spec[length++] = '%';
+      i++;
+      while (format[i] != '\0' && strchr("-+ #0123456789.", format[i]) &&
+             length < (int)sizeof(spec) - 3) {
+        spec[length++] = format[i++];
+      }
+      char conversion = format[i];
+      char* arg = next < argc ? argv[next++] : NULL;
+      if (conversion == 'd' || conversion == 'i') {
+        spec[length++] = 'l';
+        spec[length++] = conversion;
+        spec[length] = '\0';
+        printf(spec, arg != NULL ? strtol(arg, NULL, 0) : 0L);
+      } else if (conversion == 'u' || conversion == 'x' || conversion == 'X' ||
+                 conversion == 'o') {
+        spec[length++] = 'l';
+        spec[length++] = conversion;
+        spec[length] = '\0';
+        printf(spec, arg != NULL ? strtoul(arg, NULL, 0) : 0UL);
+      } else if (conversion == 'c') {
+        spec[length++] = 'c';
+        spec[length] = '\0';
+        printf(spec, arg != NULL ? arg[0] : '\0');
+      } else if (conversion == 's') {
+        spec[length++] = 's';
+        spec[length] = '\0';
+        printf(spec, arg != NULL ? arg : "");
+      } else {
+        fprintf(stderr, "printf: invalid conversion %%%c\n", conversion);
+        return 1;
+      }
+    }
+    // a format without conversions is printed once however many args remain
+    if (next == first) {
+      break;
+    }
+  } while (next < argc);
+  return 0;
+}
+
+// to copy everything from one fd to another without passing the data through
+// user space where the kernel allows it: copy_file_range between regular
+// files, splice when either side is a pipe and sendfile from a regular file,
+// with a plain read/write loop as the fallback
+int copyFd(int inputFd, int outputFd) {
+  struct stat inputInfo;
+  struct stat outputInfo;
+  if (fstat(inputFd, &inputInfo) == -1 || fstat(outputFd, &outputInfo) == -1) {
+    perror("cat");
+    return 1;
+  }
+  ssize_t copied;
+
+  if (S_ISREG(inputInfo.st_mode) && S_ISREG(outputInfo.st_mode)) {
+    while ((copied = copy_file_range(inputFd, NULL, outputFd, NULL,
+                                     CAT_CHUNK_SIZE, 0)) > 0) {
+    }
+    if (copied == 0) {
+      return 0;
+    }
+  } else if (S_ISFIFO(inputInfo.st_mode) || S_ISFIFO(outputInfo.st_mode)) {
+    while ((copied = splice(inputFd, NULL, outputFd, NULL, CAT_CHUNK_SIZE,
+                            SPLICE_F_MOVE | SPLICE_F_MORE)) > 0) {
+    }
+    if (copied == 0) {
+      return 0;
+    }
+  } else if (S_ISREG(inputInfo.st_mode)) {
+    while ((copied = sendfile(outputFd, inputFd, NULL, CAT_CHUNK_SIZE)) > 0) {
+    }
+    if (copied == 0) {
+      return 0;
+    }
+  }
+
+  // the zero-copy calls leave the offsets where they stopped, so the
+  // fallback carries on from there
+  char buffer[CAT_BUFFER_SIZE];
+  ssize_t length;
+  while ((length = read(inputFd, buffer, sizeof(buffer))) > 0) {
+    ssize_t written = 0;
+    while (written < length) {
+      ssize_t result = write(outputFd, buffer + written, length - written);
+      if (result == -1) {
+        perror("cat");
+        return 1;
+      }
+      written += result;
+    }
+  }
+  if (length == -1) {
+    perror("cat");
+    return 1;
+  }
+  return 0;
+}
+
+// to write the named files, or inputFd when there are none, to stdout
+int builtinCat(char* argv[], int argc, int inputFd) {
+  // anything already printed through stdio has to reach fd 1 first
+  fflush(stdout);
+  if (argc == 1) {
+    return copyFd(inputFd, STDOUT_FILENO);
+  }
+  int status = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-") == 0) {
+      status |= copyFd(inputFd, STDOUT_FILENO);
+      continue;
+    }
+    int fd = open(argv[i], O_RDONLY);
+    if (fd == -1) {
+      perror(argv[i]);
+      status = 1;
+      continue;
+    }
+    status |= copyFd(fd, STDOUT_FILENO);
+    close(fd);
+  }
+  return status;
+}
+
+// to parse a size such as 65536, 64K or 1M into bytes, or -1 if malformed or
+// too large for a long
+long parseSize(char* text) {
+  char* end;
+  errno = 0;
+  long size = strtol(text, &end, 10);
+  if (end == text || size < 0 || errno == ERANGE) {
+    return -1;
+  }
+  long unit = 1;
+  if (*end == 'k' || *end == 'K') {
+    unit = 1024;
+    end++;
+  } else if (*end == 'm' || *end == 'M') {
+    unit = 1024 * 1024;
+    end++;
+  } else if (*end == 'g' || *end == 'G') {
+    unit = 1024L * 1024 * 1024;
+    end++;
+  }
+  if (*end != '\0' || size > LONG_MAX / unit) {
+    return -1;
+  }
+  return size * unit;
+}
+
+// to change a shell option given as name=value, or print them all without
+// arguments; runs in the shell itself so the setting persists
+int executeSetCommand(char* command[], int command_length) {
+  if (command_length == 1) {
+    printf("pipesize=%ld\n", pipe_size);
+    fflush(stdout);
+    return 0;
+  }
+  int status = 0;
+  for (int i = 1; i < command_length; i++) {
+    if (strncmp(command[i], "pipesize=", strlen("pipesize=")) == 0) {
+      long size = parseSize(command[i] + strlen("pipesize="));
+      if (size < 0) {
+        fprintf(stderr, "set: invalid pipe size: %s\n", command[i]);
+        status = 1;
+      } else if (size > INT_MAX) {
+        // F_SETPIPE_SZ takes an int, so anything larger would wrap around
+        fprintf(stderr, "set: pipe size too large: %s\n", command[i]);
+        status = 1;
+      } else {
+        pipe_size = size;
+      }
+    } else {
+      fprintf(stderr, "set: unknown option: %s\n", command[i]);
+      status = 1;
+    }
+  }
+  return status;
+}
+
+// to write the current working directory
+int builtinPwd() {
+  char cwd[PATH_MAX];
+  if (getcwd(cwd, sizeof(cwd)) == NULL) {
+    perror("pwd");
+    return 1;
+  }
+  printf("%s\n", cwd);
+  return 0;
+}
+
+// to evaluate the expression of a test builtin: 0 when true, 1 when false
+// and 2 when the expression is malformed
+int evaluateTest(char* argv[], int argc) {
+  if (argc == 0) {
+    return 1;
+  }
+  if (strcmp(argv[0], "!") == 0) {
+    int result = evaluateTest(argv + 1, argc - 1);
+    return result == 2 ? 2 : !result;
+  }
+  if (argc == 1) {
+    return strlen(argv[0]) > 0 ? 0 : 1;
+  }
+  if (argc == 2) {
+    char* op = argv[0];
+    char* operand = argv[1];
+    struct stat info;
+    if (strcmp(op, "-n") == 0) {
+      return strlen(operand) > 0 ? 0 : 1;
+    } else if (strcmp(op, "-z") == 0) {
+      return strlen(operand) == 0 ? 0 : 1;
+    } else if (strcmp(op, "-e") == 0) {
+      return stat(operand, &info) == 0 ? 0 : 1;
+    } else if (strcmp(op, "-f") == 0) {
+      return stat(operand, &info) == 0 && S_ISREG(info.st_mode) ? 0 : 1;
+    } else if (strcmp(op, "-d") == 0) {
+      return stat(operand, &info) == 0 && S_ISDIR(info.st_mode) ? 0 : 1;
+    } else if (strcmp(op, "-s") == 0) {
+      return stat(operand, &info) == 0 && info.st_size > 0 ? 0 : 1;
+    } else if (strcmp(op, "-r") == 0) {
+      return access(operand, R_OK) == 0 ? 0 : 1;
+    } else if (strcmp(op, "-w") == 0) {
+      return access(operand, W_OK) == 0 ? 0 : 1;
+    } else if (strcmp(op, "-x") == 0) {
+      return access(operand, X_OK) == 0 ? 0 : 1;
+    }
+    fprintf(stderr, "test: %s: unary operator expected\n", op);
+    return 2;
+  }
+  if (argc == 3) {
+    char* op = argv[1];
+    if (strcmp(op, "=") == 0) {
+      return strcmp(argv[0], argv[2]) == 0 ? 0 : 1;
+    } else if (strcmp(op, "!=") == 0) {
+      return strcmp(argv[0], argv[2]) != 0 ? 0 : 1;
+    }
+    long left = strtol(argv[0], NULL, 10);
+    long right = strtol(argv[2], NULL, 10);
+    if (strcmp(op, "-eq") == 0) {
+      return left == right ? 0 : 1;
+    } else if (strcmp(op, "-ne") == 0) {
+      return left != right ? 0 : 1;
+    } else if (strcmp(op, "-lt") == 0) {
+      return left < right ? 0 : 1;
+    } else if (strcmp(op, "-le") == 0) {
+      return left <= right ? 0 : 1;
+    } else if (strcmp(op, "-gt") == 0) {
+      return left > right ? 0 : 1;
+    } else if (strcmp(op, "-ge") == 0) {
+      return left >= right ? 0 : 1;
+    }
+    fprintf(stderr, "test: %s: binary operator expected\n", op);
+    return 2;
+  }
+  fprintf(stderr, "test: too many arguments\n");
+  return 2;
+}
+
+// to run a fork-free builtin in the current process and return its status;
+// output goes through stdout, so it follows whatever fd 1 currently is, and
+// inputFd stands in for stdin
+int runBuiltin(char* argv[], int argc, int inputFd) {
+  int status = 0;
+  if (strcmp(argv[0], "cat") == 0) {
+    status = builtinCat(argv, argc, inputFd);
+  } else if (strcmp(argv[0], "echo") == 0) {
+    status = builtinEcho(argv, argc);
+  } else if (strcmp(argv[0], "printf") == 0) {
+    status = builtinPrintf(argv, argc);
+  } else if (strcmp(argv[0], "pwd") == 0) {
+    status = builtinPwd();
+  } else if (strcmp(argv[0], "true") == 0) {
+    status = 0;
+  } else if (strcmp(argv[0], "false") == 0) {
+    status = 1;
+  } else if (strcmp(argv[0], "test") == 0) {
+    status = evaluateTest(argv + 1, argc - 1);
+  } else if (strcmp(argv[0], "[") == 0) {
+    if (strcmp(argv[argc - 1], "]") != 0) {
+      fprintf(stderr, "[: missing ]\n");
+      status = 2;
+    } else {
+      status = evaluateTest(argv + 1, argc - 2);
+    }
+  }
+  // flush now so a later fork does not copy unwritten output into the child
+  fflush(stdout);
+  return status;
+}
+
+// to check whether a command can run in the shell process: a fork-free
+// builtin outside a pipeline that does not read the shell's own stdin, which
+// the reader thread may be consuming
+bool runsInShell(char* command[], int command_length) {
+  if (command_length == 0 || !isForkFreeBuiltin(command[0]) ||
+      findStringInArray("|", command, command_length) > -1) {
+    return false;
+  }
+  if (strcmp(command[0], "cat") == 0 &&
+      findStringInArray("<", command, command_length) == -1) {
+    // cat reads stdin without arguments and for every "-" among them
+    int argc = findStringInArray(">", command, command_length);
+    if (argc == -1) {
+      argc = command_length;
+    }
+    return argc > 1 && findStringInArray("-", command, argc) == -1;
+  }
+  return true;
+}
+
+// to run a fork-free builtin in the shell itself, pointing stdout at the file
+// of a > redirection for the duration of the builtin; the file of a <
+// redirection is handed over as the input fd so fd 0 is left alone
+int executeBuiltinInShell(char* command[], int command_length) {
+  int targetFd = -1;
+  int fileFd = -1;
+  int redirectionLocation = findStringInArray(">", command, command_length);
+  if (redirectionLocation > -1) {
+    targetFd = STDOUT_FILENO;
+  } else {
+    redirectionLocation = findStringInArray("<", command, command_length);
+    if (redirectionLocation > -1) {
+      targetFd = STDIN_FILENO;
+    }
+  }
+
+  int argc = command_length;
+  if (targetFd != -1) {
+    if (redirectionLocation == 0 ||
+        redirectionLocation == command_length - 1) {
+      fprintf(stderr, "Invalid redirection location.\n");
+      return 1;
+    }
+    char* filename = command[redirectionLocation + 1];
+    if (targetFd == STDOUT_FILENO) {
+      fileFd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    } else {
+      fileFd = open(filename, O_RDONLY);
+    }
+    if (fileFd == -1) {
+      perror(targetFd == STDOUT_FILENO ? "Error opening output file"
+                                       : "Error opening input file");
+      return 1;
+    }
+    argc = redirectionLocation;
+  }
+
+  if (targetFd == STDIN_FILENO) {
+    int status = runBuiltin(command, argc, fileFd);
+    close(fileFd);
+    return status;
+  }
+
+  int savedFd = -1;
+  if (targetFd == STDOUT_FILENO) {
+    fflush(stdout);
+    savedFd = dup(targetFd);
+    dup2(fileFd, targetFd);
+    close(fileFd);
+  }
+
+  int status = runBuiltin(command, argc, STDIN_FILENO);
+
+  if (targetFd == STDOUT_FILENO) {
+    dup2(savedFd, targetFd);
+    close(savedFd);
+  }
+  return status;
+}
+
+// to end a forked child that did not exec; exit() would also flush the
+// shell's stdin buffer and move the file offset the parent reads from
+_Noreturn void exitChild(int status) {
+  fflush(stdout);
+  fflush(stderr);
+  _exit(status);
+}
+
+// to turn a status from wait() into a shell exit status
+int decodeStatus(int waitStatus) {
+  if (WIFEXITED(waitStatus)) {
+    return WEXITSTATUS(waitStatus);
+  }
+  if (WIFSIGNALED(waitStatus)) {
+    return 128 + WTERMSIG(waitStatus);
+  }
+  return 1;
+}
+
+// to execute a redirection command and return its exit status
+int executeRedirCommand(char* command[],
                          int command_length,
                          char* filename[],
                          int is_output_redirection) {
@@ -202,7 +845,7 @@ void executeRedirCommand(char* command[],
       int fd = open(filename[0], O_WRONLY | O_CREAT | O_TRUNC, 0644);
       if (fd == -1) {
         perror("Error opening output file");
-        exit(EXIT_FAILURE);
+        exitChild(EXIT_FAILURE);
       }
       dup2(fd, STDOUT_FILENO);
       close(fd);
@@ -211,16 +854,18 @@ void executeRedirCommand(char* command[],
       int fd = open(filename[0], O_RDONLY);
       if (fd == -1) {
         perror("Error opening input file");
-        exit(EXIT_FAILURE);
+        exitChild(EXIT_FAILURE);
       }
       dup2(fd, STDIN_FILENO);
       close(fd);
     }
     //  Execute the command in the child process.
     executeSimpleCommand(command, command_length);
+    exitChild(0);
   } else if (child_pid > 0) {
     // Parent process
-    wait(NULL);
+    waitpid(child_pid, &status, 0);
+    return decodeStatus(status);
   } else {
     perror("Fork failed");
     exit(EXIT_FAILURE);
@@ -250,49 +895,56 @@ int findStringInArray(char* searchString, char* stringArray[], int arraySize) {
   return -1;
 }
 
-// to split the array of strings into two at a given location
+// to split the array of strings into two at a given location; both halves
+// point into the original array rather than copying it
 void splitStringArray(char** stringArray,
                       int arraySize,
                       int splitIndex,
                       char*** leftArray,
-                      int leftSize,
-                      char*** rightArray,
-                      int rightSize) {
+                      char*** rightArray) {
   if (splitIndex < 0 || splitIndex > arraySize) {
     // Invalid split index
-    leftSize = 0;
-    rightSize = 0;
     *leftArray = NULL;
     *rightArray = NULL;
     return;
   }
 
-  *leftArray = (char**)malloc((leftSize) * sizeof(char*));
-  *rightArray = (char**)malloc((rightSize) * sizeof(char*));
+  *leftArray = stringArray;
+  *rightArray = stringArray + splitIndex + 1;
+}
 
-  for (int i = 0; i < splitIndex; i++) {
-    (*leftArray)[i] = my_strdup(stringArray[i]);
+// to fork a child, execute a command and return its exit status
+int executeCommand(char* currentCommand[], int commandLength) {
+  if (commandLength > 0 && strcmp(currentCommand[0], "set") == 0) {
+    return executeSetCommand(currentCommand, commandLength);
   }
-
-  for (int i = 0; i < rightSize; i++) {
-    (*rightArray)[i] = my_strdup(stringArray[splitIndex + i + 1]);
+  // simple builtins run without a fork unless they are part of a pipeline
+  if (runsInShell(currentCommand, commandLength)) {
+    return executeBuiltinInShell(currentCommand, commandLength);
   }
-}
 
-// to fork a child and execute a command
-int executeCommand(char* currentCommand[], int commandLength) {
-  // int fd[2];
-  // pipe(fd);
-  pipe(pipe_fds);
+  // only cd needs a pipe, to send the child's new directory back; one made
+  // for every command would leak both ends into the shell and its children
+  bool changesDirectory =
+      commandLength > 0 && strcmp(currentCommand[0], "cd") == 0;
+  if (changesDirectory && pipe(pipe_fds) == -1) {
+    perror("pipe");
+    return 1;
+  }
   pid_t child_pid;
   child_pid = fork();
 
   if (child_pid == -1) {
     perror("Fork failed");
-    return 0;
+    if (changesDirectory) {
+      close(pipe_fds[0]);
+      close(pipe_fds[1]);
+    }
+    return 1;
   }
 
   if (child_pid == 0) {
+    int status = 0;
     if (isArrayEmpty(currentCommand)) {
     } else if (findStringInArray("|", currentCommand, commandLength) > -1) {
       int pipeLocation = findStringInArray("|", currentCommand, commandLength);
@@ -301,44 +953,24 @@ int executeCommand(char* currentCommand[], int commandLength) {
       char** rightCommand;
       int rightCommandLength = commandLength - pipeLocation - 1;
       splitStringArray(currentCommand, commandLength, pipeLocation,
-                       &leftCommand, leftCommandLength, &rightCommand,
-                       rightCommandLength);
-      executePipeCommand(leftCommand, leftCommandLength, rightCommand,
-                         rightCommandLength);
-
-      for (int i = 0; i < leftCommandLength; i++) {
-        free(leftCommand[i]);
-      }
-      free(leftCommand);
-      for (int i = 0; i < rightCommandLength; i++) {
-        free(rightCommand[i]);
-      }
-      free(rightCommand);
+                       &leftCommand, &rightCommand);
+      status = executePipeCommand(leftCommand, leftCommandLength,
+                                  rightCommand, rightCommandLength);
     } else if (findStringInArray(">", currentCommand, commandLength) > -1) {
       int redirectionLocation =
           findStringInArray(">", currentCommand, commandLength);
       if (redirectionLocation == 0 ||
           redirectionLocation == commandLength - 1) {
         fprintf(stderr, "Invalid redirection location.\n");
-        exit(EXIT_FAILURE);
+        exitChild(EXIT_FAILURE);
       } else {
         char** leftCommand;
         char** filename;
         int leftCommandLength = redirectionLocation;
-        int filenameLength =
-            1;  // will always be one as the file is a single token
         splitStringArray(currentCommand, commandLength, redirectionLocation,
-                         &leftCommand, leftCommandLength, &filename,
-                         filenameLength);
-        executeRedirCommand(leftCommand, leftCommandLength, filename, 1);
-        for (int i = 0; i < leftCommandLength + 1; i++) {
-          free(leftCommand[i]);
-        }
-        free(leftCommand);
-        for (int i = 0; i < filenameLength; i++) {
-          free(filename[i]);
-        }
-        free(filename);
+                         &leftCommand, &filename);
+        status =
+            executeRedirCommand(leftCommand, leftCommandLength, filename, 1);
       }
     } else if (findStringInArray("<", currentCommand, commandLength) > -1) {
       int redirectionLocation =
@@ -346,97 +978,38 @@ int executeCommand(char* currentCommand[], int commandLength) {
       if (redirectionLocation == 0 ||
           redirectionLocation == commandLength - 1) {
         fprintf(stderr, "Invalid redirection location.\n");
-        exit(EXIT_FAILURE);
+        exitChild(EXIT_FAILURE);
       } else {
         char** leftCommand;
         char** filename;
         int leftCommandLength = redirectionLocation;
-        int filenameLength =
-            1;  // will always be one as the file is a single token
         splitStringArray(currentCommand, commandLength, redirectionLocation,
-                         &leftCommand, leftCommandLength, &filename,
-                         filenameLength);
-        executeRedirCommand(leftCommand, leftCommandLength, filename, 0);
-        for (int i = 0; i < leftCommandLength; i++) {
-          free(leftCommand[i]);
-        }
-        free(leftCommand);
-        for (int i = 0; i < filenameLength; i++) {
-          free(filename[i]);
-        }
-        free(filename);
+                         &leftCommand, &filename);
+        status =
+            executeRedirCommand(leftCommand, leftCommandLength, filename, 0);
       }
     } else {
       executeSimpleCommand(currentCommand, commandLength);
-      // exit(0);
     }
+    // builtins return here instead of exec'ing, so the child has to stop
+    // before it falls back into the read loop of main()
+    exitChild(status);
   } else {
-    wait(NULL);
-    if (strcmp(currentCommand[0], "cd") == 0) {
+    int status;
+    waitpid(child_pid, &status, 0);
+    if (changesDirectory) {
       close(pipe_fds[1]); //close the write end of the pipe
       char cwd[MAX_INPUT_LENGTH];
-      int readLength = read(pipe_fds[0], cwd, MAX_INPUT_LENGTH);
-      cwd[readLength] = 0;
+      int readLength = read(pipe_fds[0], cwd, MAX_INPUT_LENGTH - 1);
       close(pipe_fds[0]);
-      chdir(cwd);
-    }
-    return 0;
-  }
-}
-
-// to create a subarray from the tokens array which contains the current command
-// to process
-int getCurrentCommand(char* tokens[],
-                      int startIdx,
-                      int endIdx,
-                      int* commandLength,
-                      char*** currentCommand) {
-  *commandLength = endIdx - startIdx;
-  if (*(commandLength) == 0)
-    return 0;
-  *currentCommand = (char**)malloc((*commandLength) * sizeof(char*));
-  if (startIdx == 0) {
-    for (int i = startIdx; i < (*commandLength); i++) {
-      (*currentCommand)[i] =
-          (char*)malloc(sizeof(char) * (strlen(tokens[i]) + 1));
-      assert((*currentCommand)[i] != NULL);
-
-      strcpy((*currentCommand)[i], tokens[i]);
-    }
-  } else {
-    for (int i = startIdx; i < ((*commandLength) + startIdx); i++) {
-      (*currentCommand)[i - startIdx] =
-          (char*)malloc(sizeof(char) * (strlen(tokens[i]) + 1));
-      assert((*currentCommand)[i - startIdx] != NULL);
-
-      strcpy((*currentCommand)[i - startIdx], tokens[i]);
+      // nothing arrives when the child could not change directory
+      if (readLength > 0) {
+        cwd[readLength] = 0;
+        chdir(cwd);
+      }
     }
+    return decodeStatus(status);
   }
-  return (*(commandLength));
-}
-
-// to identify the elements in the tokenize array that are ; and return an array
-// of such indices
-int* findSemicolonIndices(char* tokens[],
-                          int token_count,
-                          int* semicolonCount) {
-  int* semicolonIndices = (int*)malloc(sizeof(int));
-  *semicolonCount = 0;
-  for (int i = 0; i < token_count; i++) {
-    if (strcmp(tokens[i], ";") == 0) {
-      semicolonIndices[(*semicolonCount)] = i;
-      (*semicolonCount)++;
-      semicolonIndices = (int*)realloc(semicolonIndices,
-                                       ((*semicolonCount) + 1) * sizeof(int));
-    }
-  }
-  // we also need to assume that the tokens array has a semicolon at the very
-  // end of the array as an additional element so that we can properly get our
-  // last command
-  (*semicolonCount)++;
-  semicolonIndices[(*semicolonCount) - 1] = token_count;
-
-  return semicolonIndices;
 }
 
 // to find the first occurance of a particular string in a array of strings
@@ -452,117 +1025,55 @@ int findIndex(char* input, char* array[], int size) {
 
 int main() {
   printf("Welcome to mini-shell.\n");
-  char* prev_tokens[MAX_TOKENS];
-  int prev_token_count = 0;
+  // every line is read, compiled and run out of one arena, reset once the
+  // line is done; a line that becomes the prev program keeps its arena until
+  // the next one replaces it, so two arenas take turns
+  Arena arenas[2];
+  arenaInit(&arenas[0], ARENA_BLOCK_SIZE);
+  arenaInit(&arenas[1], ARENA_BLOCK_SIZE);
+  int current = 0;
+  // the last compiled command line, which prev runs again
+  Program* prev_program = NULL;
 
-  bool use_prev = false;
-  int status_code = 0;
-  char status_char = 'c';
+  // piped scripts are parsed ahead on a reader thread while commands run
+  LineReader reader;
+  startLineReader(&reader, stdin, useReadahead(stdin));
   while (1) {
-    char input[MAX_INPUT_LENGTH];
-    char* tokens[MAX_TOKENS];
+    char** tokens;
     int token_count = 0;
-    int semicolonCount = 0;
+    line_arena = &arenas[current];
 
-    if (status_char == 'p') {
-      use_prev = true;
-    }
-
-    // Read a single line from standard input
+    // Read a single line, or a whole if/while/for block, from standard input
     printf("shell $ ");
     fflush(stdout);
-    if (fgets(input, MAX_INPUT_LENGTH, stdin) != NULL) {
-      // Call the tokenize function to extract and store tokens in the arra
-      tokenize(input, tokens, &token_count);
-    } else {
+    if (!readBlock(&reader, line_arena, &tokens, &token_count, true) ||
+        (token_count > 0 && strcmp(tokens[0], "exit") == 0)) {
+      stopLineReader(&reader);
       fflush(stdout);
       printf("Bye bye.");
-      for (int i = 0; i < token_count; i++) {
-        free(tokens[i]);
-      }
-      for (int i = 0; i < prev_token_count; i++) {
-        free(prev_tokens[i]);
-      }
+      arenaFree(&arenas[0]);
+      arenaFree(&arenas[1]);
       return 0;
     }
 
-    if (strcmp(tokens[0], "prev") == 0) {
-      int* semicolonIndices =
-          findSemicolonIndices(prev_tokens, prev_token_count, &semicolonCount);
-
-      int startIdx = 0;
-      int endIdx = semicolonIndices[0];
-      char** currentCommand = NULL;
-      int commandLength = 0;
-      for (int i = 0; i < semicolonCount; i++) {
-        getCurrentCommand(prev_tokens, startIdx, endIdx, &commandLength,
-                          &currentCommand);
-        executeCommand(currentCommand, commandLength);
-
-        for (int i = 0; i < commandLength; i++) {
-          free(currentCommand[i]);
-        }
-        free(currentCommand);
-      }
-      free(semicolonIndices);
-
-      for (int i = 0; i < token_count; i++) {
-        free(tokens[i]);
-      }
-    } else if (strcmp(tokens[0], "exit") == 0) {
-      fflush(stdout);
-      printf("Bye bye.");
-      for (int i = 0; i < token_count; i++) {
-        free(tokens[i]);
+    if (token_count == 0) {
+      arenaReset(line_arena);
+    } else if (strcmp(tokens[0], "prev") == 0) {
+      if (prev_program != NULL) {
+        runProgram(prev_program);
       }
-      for (int i = 0; i < prev_token_count; i++) {
-        free(prev_tokens[i]);
-      }
-      return 0;
+      arenaReset(line_arena);
     } else {
-      prev_token_count = token_count;
-      for (int i = 0; i < token_count; i++) {
-        prev_tokens[i] = my_strdup(tokens[i]);
-      }
-
-      int* semicolonIndices =
-          findSemicolonIndices(tokens, token_count, &semicolonCount);
-
-      int startIdx = 0;
-      int endIdx = semicolonIndices[0];
-      char** currentCommand = NULL;
-      int commandLength = 0;
-      for (int i = 0; i < semicolonCount; i++) {
-        if (getCurrentCommand(tokens, startIdx, endIdx, &commandLength,
-                              &currentCommand) == 0) {
-          for (int i = 0; i < commandLength; i++) {
-            free(currentCommand[i]);
-          }
-          break;
-        } else {
-          executeCommand(currentCommand, commandLength);
-
-          if ((i + 1) != semicolonCount) {
-            startIdx = semicolonIndices[i] + 1;
-            endIdx = semicolonIndices[i + 1];
-          }
-
-          for (int i = 0; i < commandLength; i++) {
-            free(currentCommand[i]);
-          }
-          free(currentCommand);
-        }
+      // the line is compiled once, in the arena that already holds its tokens
+      Program* program = compileProgram(line_arena, tokens, token_count);
+      if (program != NULL) {
+        runProgram(program);
+        prev_program = program;
+        current = 1 - current;
       }
-      for (int i = 0; i < token_count; i++) {
-        free(tokens[i]);
-      }
-      free(semicolonIndices);
+      arenaReset(&arenas[current]);
     }
   }
 
-  for (int i = 0; i < MAX_TOKENS; i++) {
-    free(prev_tokens[i]);
-  }
-
   return 0;
 }
\ No newline at end of file
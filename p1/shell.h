@@ -1,14 +1,26 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <stdbool.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <limits.h>
+#include <errno.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <assert.h>
 #define MAX_INPUT_LENGTH 255
 #define MAX_TOKENS 100
+// headroom left in the exec argument space, as xargs does
+#define BATCH_ARG_HEADROOM 2048
+#define BATCH_MIN_ARG_SPACE 4096
+#define BATCH_INITIAL_ITEMS 64
+// bytes asked of one zero-copy call, and the buffer of the read/write fallback
+#define CAT_CHUNK_SIZE (1 << 30)
+#define CAT_BUFFER_SIZE (64 * 1024)
 
 #ifndef SHELL_H
 #define SHELL_H
@@ -20,11 +32,48 @@ int executePipeCommand(char* leftCommand[],
 
 char** addNullTerminator(char* array[], int size);
 
-void freeStringArray(char** array);
-
 void executeSimpleCommand(char* command[], int command_length);
 
-void executeRedirCommand(char* command[],
+long getArgumentSpace();
+
+void runBatch(char* args[], int argCount, int* running, int maxJobs,
+              bool* failed);
+
+void executeBatchCommand(char* command[], int command_length);
+
+bool isForkFreeBuiltin(char* name);
+
+bool isShellBuiltin(char* name);
+
+int builtinEcho(char* argv[], int argc);
+
+int printEscape(const char* escape);
+
+int builtinPrintf(char* argv[], int argc);
+
+int copyFd(int inputFd, int outputFd);
+
+int builtinCat(char* argv[], int argc, int inputFd);
+
+long parseSize(char* text);
+
+int executeSetCommand(char* command[], int command_length);
+
+int builtinPwd();
+
+int evaluateTest(char* argv[], int argc);
+
+int runBuiltin(char* argv[], int argc, int inputFd);
+
+bool runsInShell(char* command[], int command_length);
+
+int executeBuiltinInShell(char* command[], int command_length);
+
+int decodeStatus(int waitStatus);
+
+_Noreturn void exitChild(int status);
+
+int executeRedirCommand(char* command[],
                          int command_length,
                          char* filename[],
                          int is_output_redirection);
@@ -39,22 +88,10 @@ void splitStringArray(char** stringArray,
                       int arraySize,
                       int splitIndex,
                       char*** leftArray,
-                      int leftSize,
-                      char*** rightArray,
-                      int rightSize);
+                      char*** rightArray);
 
 int executeCommand(char* currentCommand[], int commandLength);
 
-int getCurrentCommand(char* tokens[],
-                       int startIdx,
-                       int endIdx,
-                       int* commandLength,
-                       char*** currentCommand);
-
-int* findSemicolonIndices(char* tokens[],
-                          int token_count,
-                          int* semicolonCount);
-
 int findIndex( char* input,  char* array[], int size);
 
 #endif
\ No newline at end of file
@@ -105,6 +105,178 @@ class ShellTests(ShellTestCase):
         actual = self.run_shell(script)
         self.assertEqual(actual, "one\ntwo\nthree")
 
+    def test10(self):
+        """ batch packs input lines into as few commands as possible """
+        actual = self.run_shell("batch -a numbers.txt echo x")
+        self.assertEqual(actual, "x 1 2 5 4")
+
+    def test11(self):
+        """ batch -n limits the number of lines per command """
+        actual = self.run_shell("batch -n 3 echo < numbers.txt")
+        self.assertEqual(actual, "1 2 5\n4")
+
+    def test12(self):
+        """ source runs every line of a script in order """
+        with open("script.sh", "w") as f:
+            f.write("".join("echo line%d\n" % i for i in range(300)))
+        actual = self.run_shell("source script.sh")
+        self.assertEqual(actual, "\n".join("line%d" % i for i in range(300)))
+
+        sh("rm -f script.sh")
+
+    def test13(self):
+        """ echo, printf and pwd builtins honour output redirection """
+        script = \
+            'echo one two > out.txt\n'\
+            'cat out.txt\n'\
+            'printf "%s=%03d\\n" a 7 b 8 > out.txt\n'\
+            'cat out.txt\n'\
+            'pwd'
+        actual = self.run_shell(script)
+        self.assertEqual(actual, "one two\na=007\nb=008\n" + os.getcwd())
+
+        sh("rm -f out.txt")
+
+    def test14(self):
+        """ Pipelines connect every stage """
+        actual = self.run_shell("echo one two | cat | wc -w")
+        self.assertEqual(actual, "2")
+
+    def test15(self):
+        """ cat builtin copies files through pipes and redirections """
+        script = \
+            'set pipesize=1M\n'\
+            'cat numbers.txt numbers.txt > out.txt\n'\
+            'cat out.txt | wc -l'
+        actual = self.run_shell(script)
+        self.assertEqual(actual, "10")
+
+        sh("rm -f out.txt")
+
+    def test16(self):
+        """ if/elif/else branches on exit statuses """
+        script = \
+            'if grep -q 5 numbers.txt; then echo found; else echo missing; fi\n'\
+            'if grep -q 9 numbers.txt; then echo found; elif false; then echo no; else echo missing; fi'
+        actual = self.run_shell(script)
+        self.assertEqual(actual, "found\nmissing")
+
+    def test17(self):
+        """ for loops bind each word, also across several lines """
+        script = \
+            'for x in a b\n'\
+            'do\n'\
+            '  for y in 1 2; do echo $x $y; done\n'\
+            'done'
+        actual = self.run_shell(script)
+        self.assertEqual(actual, "a 1\na 2\nb 1\nb 2")
+
+    def test18(self):
+        """ while loops rerun their condition """
+        script = \
+            'touch flag.txt\n'\
+            'while test -f flag.txt; do rm flag.txt; echo once; done\n'\
+            'while false; do echo never; done'
+        actual = self.run_shell(script)
+        self.assertEqual(actual, "once")
+
+    def test19(self):
+        """ A mixed script read from a file runs once, with and without read-ahead """
+        outputs = []
+        for readahead in ["1", "0"]:
+            with open("tests/mixed_script.txt") as script:
+                exe = subprocess.Popen(
+                        SHELL,
+                        stdin = script,
+                        stdout = subprocess.PIPE,
+                        stderr = subprocess.STDOUT,
+                        env = dict(os.environ, MINISHELL_READAHEAD = readahead)
+                      )
+                try:
+                    (outb, _) = exe.communicate(timeout = 10)
+                except subprocess.TimeoutExpired:
+                    exe.kill()
+                    (outb, _) = exe.communicate()
+            self.assertEqual(exe.returncode, 0)
+            outputs.append(filter_shell_output(try_decode(outb)))
+
+        self.assertEqual(outputs[0], outputs[1])
+        self.assertEqual(outputs[0].count("hello world"), 8)
+
+    def test20(self):
+        """ exit returns at once while piped input is still open """
+        exe = subprocess.Popen(
+                SHELL,
+                stdin = subprocess.PIPE,
+                stdout = subprocess.DEVNULL,
+                stderr = subprocess.DEVNULL
+              )
+        exe.stdin.write(b"exit\n")
+        exe.stdin.flush()
+        try:
+            rc = exe.wait(timeout = 2)
+        except subprocess.TimeoutExpired:
+            exe.kill()
+            rc = None
+        exe.stdin.close()
+        exe.wait()
+        self.assertEqual(rc, 0)
+
+    def test21(self):
+        """ set rejects pipe sizes that do not fit in an int """
+        script = \
+            'set pipesize=4G\n'\
+            'set\n'\
+            'echo still | cat'
+        actual = self.run_shell(script)
+        self.assertEqual(actual,
+                         "set: pipe size too large: pipesize=4G\n"
+                         "pipesize=0\n"
+                         "still")
+
+    def test22(self):
+        """ syntax errors name the keyword that is missing """
+        script = \
+            'if true then echo x; fi\n'\
+            'while false do echo x; done\n'\
+            'fi\n'\
+            'echo after'
+        actual = self.run_shell(script)
+        self.assertEqual(actual,
+                         "syntax error: expected 'then'\n"
+                         "syntax error: expected 'do'\n"
+                         "syntax error: unexpected 'fi'\n"
+                         "after")
+
+    @unittest.skipUnless(os.path.isdir("/proc/self/fd"), "needs /proc")
+    def test23(self):
+        """ forked commands do not leave file descriptors open """
+        script = \
+            'for i in 1 2 3 4 5 6 7 8 9 10; do ls > /dev/null; done\n'\
+            'cd .\n'\
+            'ls /proc/self/fd'
+        actual = self.run_shell(script)
+        # stdin, stdout, stderr and the directory ls is listing
+        self.assertEqual(actual, "0\n1\n2\n3")
+
+    def test24(self):
+        """ A for-list of more words than MAX_TOKENS fits on one line """
+        words = " ".join(chr(ord("a") + i % 26) for i in range(110))
+        script = \
+            'for x in ' + words + '; do true; done\n'\
+            'echo after'
+        setting = os.environ.get("MINISHELL_READAHEAD")
+        try:
+            for readahead in ["1", "0"]:
+                os.environ["MINISHELL_READAHEAD"] = readahead
+                actual = self.run_shell(script)
+                self.assertEqual(actual, "after")
+        finally:
+            if setting is None:
+                del os.environ["MINISHELL_READAHEAD"]
+            else:
+                os.environ["MINISHELL_READAHEAD"] = setting
+
 if __name__ == '__main__':
     print(f"-= {YELLOW}Running tests for {SHELL}{RESET} =-")
     unittest.main(testRunner = unittest.TextTestRunner(resultclass = PrettierTextTestResult))
@@ -49,6 +49,32 @@ class ShellTests(ShellTestCase):
                 sh("echo 'foo \"Lorem ipsum dolor sit amet\" < bar \"consectetur (adipiscing; >elit\"' | ./tokenize"), 
                 "foo\nLorem ipsum dolor sit amet\n<\nbar\nconsectetur (adipiscing; >elit")
 
+    def test07(self):
+        """Streams every line of stdin and of file arguments"""
+        self.assertEqual(sh("printf 'a b\\nc|d' | ./tokenize --all"), "a\nb\nc\n|\nd")
+        with open("lines.txt", "w") as f:
+            f.write("ls -l\necho hi > out\n")
+        self.assertEqual(
+                sh("./tokenize -j 2 lines.txt lines.txt"),
+                "ls\n-l\necho\nhi\n>\nout\nls\n-l\necho\nhi\n>\nout")
+        sh("rm -f lines.txt")
+
+    def test08(self):
+        """Writes tagged, length-prefixed tokens in binary mode"""
+        out = proc.run([TOKENIZE, "--binary"], input = b'foo "x y" |\n',
+                       capture_output = True).stdout
+        self.assertEqual(
+                out,
+                b"w\x03\x00foo" b"s\x03\x00x y" b"o\x01\x00|" b"e\x00\x00")
+
+    def test09(self):
+        """Reports line and token counts with --stats"""
+        result = proc.run([TOKENIZE, "--stats"], input = b"ls -l\necho hi > out\n",
+                          capture_output = True)
+        stats = try_decode(result.stderr)
+        self.assertRegex(stats, "lines: 2")
+        self.assertRegex(stats, "tokens: 6")
+
 
 
 if __name__ == '__main__':
@@ -1,6 +1,288 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
 #include "tokens.h"
+// stdio buffer used for streamed input and output
+#define STREAM_BUFFER_SIZE (1 << 20)
 
-int main() {
+// totals reported by --stats
+typedef struct {
+  long lines;
+  long tokens;
+  long bytes;
+} TokenStats;
+
+// one file argument; its worker writes straight to stdout while it is the
+// file's turn and to a temporary spill file before that
+typedef struct {
+  char* path;
+  int index;
+  atomic_int* turn;
+  FILE* spill;
+  TokenStats stats;
+  bool failed;
+  bool done;
+} FileJob;
+
+// the files shared by the workers; each takes the next unclaimed file, and
+// only the file whose turn it is may write to stdout
+typedef struct {
+  FileJob* jobs;
+  int count;
+  atomic_int next;
+  atomic_int turn;
+  bool binary;
+  pthread_mutex_t lock;
+  pthread_cond_t finished;
+} WorkQueue;
+
+/*
+    Function to write one token, either on a line of its own or as a binary
+    record: a TokenKind tag byte, a 16-bit little-endian length and the bytes
+*/
+void writeToken(FILE* out, char* token, int kind, bool binary) {
+  if (!binary) {
+    fputs(token, out);
+    fputc('\n', out);
+    return;
+  }
+  size_t length = strlen(token);
+  fputc(kind, out);
+  fputc(length & 0xff, out);
+  fputc((length >> 8) & 0xff, out);
+  fwrite(token, 1, length, out);
+}
+
+/*
+    Function to append everything written to a spill file to out
+*/
+void copySpill(FILE* spill, FILE* out) {
+  char buffer[STREAM_BUFFER_SIZE / 16];
+  size_t length;
+  rewind(spill);
+  while ((length = fread(buffer, 1, sizeof(buffer), spill)) > 0) {
+    fwrite(buffer, 1, length, out);
+  }
+}
+
+/*
+    Function to pick where a job writes its next line: its spill file until
+    it is the job's turn, then stdout, once what was spilled is copied out
+*/
+FILE* jobOutput(FileJob* job) {
+  if (job->spill != NULL && atomic_load(job->turn) == job->index) {
+    copySpill(job->spill, stdout);
+    fclose(job->spill);
+    job->spill = NULL;
+  }
+  return job->spill != NULL ? job->spill : stdout;
+}
+
+/*
+    Function to tokenize every line of a file; lines longer than the shell
+    accepts are split the same way the shell's fgets splits them. A job, if
+    given, picks the output of each line
+*/
+void tokenizeStream(FILE* in,
+                    FILE* out,
+                    bool binary,
+                    TokenStats* stats,
+                    FileJob* job) {
+  char input[MAX_INPUT_LENGTH];
+  // every character of a line can at most become one token
+  char* tokens[MAX_INPUT_LENGTH];
+  int kinds[MAX_INPUT_LENGTH];
+  bool lineOpen = false;
+  // the tokens of a line only live until the next line is read
+  Arena arena;
+  arenaInit(&arena, ARENA_BLOCK_SIZE);
+
+  setvbuf(in, NULL, _IOFBF, STREAM_BUFFER_SIZE);
+  while (fgets(input, MAX_INPUT_LENGTH, in) != NULL) {
+    int token_count = 0;
+    size_t length = strlen(input);
+    stats->bytes += length;
+    tokenizeKinds(&arena, input, tokens, kinds, &token_count);
+    if (job != NULL) {
+      out = jobOutput(job);
+    }
+    for (int i = 0; i < token_count; i++) {
+      writeToken(out, tokens[i], kinds[i], binary);
+    }
+    arenaReset(&arena);
+    stats->tokens += token_count;
+
+    lineOpen = length > 0 && input[length - 1] != '\n';
+    if (!lineOpen) {
+      stats->lines++;
+      if (binary) {
+        writeToken(out, "", TOKEN_END_OF_LINE, binary);
+      }
+    }
+  }
+  // a last line without a newline still counts
+  if (lineOpen) {
+    stats->lines++;
+    if (binary) {
+      writeToken(out, "", TOKEN_END_OF_LINE, binary);
+    }
+  }
+  arenaFree(&arena);
+}
+
+/*
+    Function to add the stats of one input to the totals
+*/
+void addStats(TokenStats* total, TokenStats* part) {
+  total->lines += part->lines;
+  total->tokens += part->tokens;
+  total->bytes += part->bytes;
+}
+
+/*
+    Function run by each worker thread: tokenize unclaimed files until there
+    are none left, spilling output only while it is not yet the file's turn
+*/
+void* tokenizeWorker(void* arg) {
+  WorkQueue* queue = (WorkQueue*)arg;
+  int index;
+  while ((index = atomic_fetch_add(&queue->next, 1)) < queue->count) {
+    FileJob* job = &queue->jobs[index];
+    FILE* in = fopen(job->path, "r");
+    if (in == NULL) {
+      perror(job->path);
+      job->failed = true;
+    } else {
+      bool ownTurn = atomic_load(&queue->turn) == index;
+      job->spill = ownTurn ? NULL : tmpfile();
+      if (!ownTurn && job->spill == NULL) {
+        perror("tmpfile");
+        job->failed = true;
+      } else {
+        tokenizeStream(in, job->spill != NULL ? job->spill : stdout,
+                       queue->binary, &job->stats, job);
+      }
+      fclose(in);
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    job->done = true;
+    pthread_cond_broadcast(&queue->finished);
+    pthread_mutex_unlock(&queue->lock);
+  }
+  return NULL;
+}
+
+/*
+    Function to tokenize files on several worker threads, writing their output
+    to stdout in the order the files were given
+*/
+int tokenizeFilesInParallel(char* paths[],
+                            int path_count,
+                            int workers,
+                            bool binary,
+                            TokenStats* stats) {
+  WorkQueue queue;
+  queue.jobs = (FileJob*)calloc(path_count, sizeof(FileJob));
+  if (queue.jobs == NULL) {
+    fprintf(stderr, "Memory allocation failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < path_count; i++) {
+    queue.jobs[i].path = paths[i];
+    queue.jobs[i].index = i;
+    queue.jobs[i].turn = &queue.turn;
+  }
+  queue.count = path_count;
+  atomic_init(&queue.next, 0);
+  atomic_init(&queue.turn, 0);
+  queue.binary = binary;
+  pthread_mutex_init(&queue.lock, NULL);
+  pthread_cond_init(&queue.finished, NULL);
+
+  pthread_t* threads = (pthread_t*)malloc(workers * sizeof(pthread_t));
+  if (threads == NULL) {
+    fprintf(stderr, "Memory allocation failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < workers; i++) {
+    pthread_create(&threads[i], NULL, tokenizeWorker, &queue);
+  }
+
+  // files take turns in argument order; a file that finished before its turn
+  // came has its spilled output copied out here
+  int status = 0;
+  for (int i = 0; i < path_count; i++) {
+    FileJob* job = &queue.jobs[i];
+    pthread_mutex_lock(&queue.lock);
+    while (!job->done) {
+      pthread_cond_wait(&queue.finished, &queue.lock);
+    }
+    pthread_mutex_unlock(&queue.lock);
+
+    if (job->spill != NULL) {
+      copySpill(job->spill, stdout);
+      fclose(job->spill);
+    }
+    if (job->failed) {
+      status = 1;
+    } else {
+      addStats(stats, &job->stats);
+    }
+    atomic_store(&queue.turn, i + 1);
+  }
+
+  for (int i = 0; i < workers; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  pthread_mutex_destroy(&queue.lock);
+  pthread_cond_destroy(&queue.finished);
+  free(queue.jobs);
+  return status;
+}
+
+/*
+    Function to tokenize files one after another straight to stdout
+*/
+int tokenizeFiles(char* paths[], int path_count, bool binary,
+                  TokenStats* stats) {
+  int status = 0;
+  for (int i = 0; i < path_count; i++) {
+    FILE* in = fopen(paths[i], "r");
+    if (in == NULL) {
+      perror(paths[i]);
+      status = 1;
+      continue;
+    }
+    tokenizeStream(in, stdout, binary, stats, NULL);
+    fclose(in);
+  }
+  return status;
+}
+
+/*
+    Function to print the usage of the tokenize demo
+*/
+void printUsage() {
+  fprintf(stderr,
+          "usage: tokenize                      tokenize one line of stdin\n"
+          "       tokenize [--all] [--binary] [--stats] [-j workers] "
+          "[file...]\n"
+          "  --all      tokenize every line of stdin\n"
+          "  --binary   write tag, 16-bit length, bytes records; an 'e' "
+          "record ends each line\n"
+          "  --stats    print lines, tokens and MB/s to stderr\n"
+          "  -j         files tokenized at once (default: one per core)\n");
+}
+
+/*
+    Function to tokenize a single line of stdin, as the original demo did
+*/
+int tokenizeOneLine() {
   char input[MAX_INPUT_LENGTH];
   char* tokens[MAX_TOKENS];
   int token_count = 0;
@@ -17,4 +299,73 @@ int main() {
   }
 
   return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc == 1) {
+    return tokenizeOneLine();
+  }
+
+  bool binary = false;
+  bool showStats = false;
+  long workers = sysconf(_SC_NPROCESSORS_ONLN);
+  char** paths = (char**)malloc(argc * sizeof(char*));
+  int path_count = 0;
+  if (paths == NULL) {
+    fprintf(stderr, "Memory allocation failed.\n");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--all") == 0) {
+      // streaming stdin is what happens anyway once there are no files
+    } else if (strcmp(argv[i], "--binary") == 0) {
+      binary = true;
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      showStats = true;
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      workers = atol(argv[++i]);
+    } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+      printUsage();
+      free(paths);
+      return 2;
+    } else {
+      paths[path_count++] = argv[i];
+    }
+  }
+  if (workers < 1) {
+    workers = 1;
+  }
+  if (workers > path_count) {
+    workers = path_count;
+  }
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  setvbuf(stdout, NULL, _IOFBF, STREAM_BUFFER_SIZE);
+  TokenStats stats = {0, 0, 0};
+  int status = 0;
+  if (path_count == 0) {
+    tokenizeStream(stdin, stdout, binary, &stats, NULL);
+  } else if (workers <= 1) {
+    status = tokenizeFiles(paths, path_count, binary, &stats);
+  } else {
+    status = tokenizeFilesInParallel(paths, path_count, (int)workers, binary,
+                                     &stats);
+  }
+  fflush(stdout);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (showStats) {
+    double seconds =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double megabytes = stats.bytes / 1e6;
+    fprintf(stderr, "lines: %ld\ntokens: %ld\nMB: %.2f\nMB/s: %.2f\n",
+            stats.lines, stats.tokens, megabytes,
+            seconds > 0 ? megabytes / seconds : 0.0);
+  }
+
+  free(paths);
+  return status;
 }
\ No newline at end of file
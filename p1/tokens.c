@@ -16,6 +16,35 @@ char* my_strdup(const char* s) {
     Function to tokenize a string and store the tokens in an array
 */
 void tokenize(char* input, char* tokens[], int* token_count) {
+  tokenizeKinds(NULL, input, tokens, NULL, token_count);
+}
+
+/*
+    Function to copy a token into the arena, or onto the heap without one
+*/
+char* copyToken(Arena* arena, const char* s) {
+  return arena != NULL ? arenaStrdup(arena, s) : my_strdup(s);
+}
+
+/*
+    Function to record the kind of the token just stored, if kinds are wanted
+*/
+void setTokenKind(int kinds[], int index, int kind) {
+  if (kinds != NULL) {
+    kinds[index] = kind;
+  }
+}
+
+/*
+    Function to tokenize a string, storing the tokens in an array and, when
+    kinds is not NULL, the TokenKind of each token in kinds. The tokens are
+    allocated from the arena, or with malloc when it is NULL
+*/
+void tokenizeKinds(Arena* arena,
+                   char* input,
+                   char* tokens[],
+                   int kinds[],
+                   int* token_count) {
   char* token;
   int in_quote = 0;
 
@@ -30,8 +59,9 @@ void tokenize(char* input, char* tokens[], int* token_count) {
         // If we were inside a quote, we have reached the end
         in_quote = 0;
         quote_content[quote_index] = '\0';  // Null-terminate the content
+        setTokenKind(kinds, *token_count, TOKEN_STRING);
         tokens[(*token_count)++] =
-            my_strdup(quote_content);  // Store the content within quotes as a
+            copyToken(arena, quote_content);  // Store the content within quotes as a
                                        // single token
         quote_index = 0;               // Reset the index
       } else {
@@ -45,12 +75,13 @@ void tokenize(char* input, char* tokens[], int* token_count) {
     } else if (strchr(";<>()|", input[i]) != NULL) {
       // If a special char, treat it as a separate token
       char char_token[] = {input[i], '\0'};
-      tokens[(*token_count)++] = my_strdup(char_token);
+      setTokenKind(kinds, *token_count, TOKEN_OPERATOR);
+      tokens[(*token_count)++] = copyToken(arena, char_token);
     } else if (input[i] != ' ' && input[i] != '\n' && input[i] != '\t') {
       // If not inside a quote, not whitespace, and not a semicolon, store the
       // character
 
-      char* word = (char*)malloc(MAX_INPUT_LENGTH);
+      char word[MAX_INPUT_LENGTH];
       int word_index = 0;
       while (input[i] != '\0' && input[i] != ' ' && input[i] != '\n' &&
              input[i] != '\t' && (strchr(";<>()|", input[i]) == NULL)) {
@@ -59,13 +90,15 @@ void tokenize(char* input, char* tokens[], int* token_count) {
       }
 
       word[word_index] = '\0';
-      tokens[(*token_count)++] = word;
+      setTokenKind(kinds, *token_count, TOKEN_WORD);
+      tokens[(*token_count)++] = copyToken(arena, word);
 
       while (input[i] != '\0' && input[i] != ' ' && input[i] != '\n' &&
              input[i] != '\t') {
         if (strchr(";<>()|", input[i]) != NULL) {
           char char_token[] = {input[i], '\0'};
-          tokens[(*token_count)++] = my_strdup(char_token);
+          setTokenKind(kinds, *token_count, TOKEN_OPERATOR);
+          tokens[(*token_count)++] = copyToken(arena, char_token);
           i++;
         } else {
           i--;
@@ -1,13 +1,27 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include "arena.h"
 #define MAX_INPUT_LENGTH 255
 #define MAX_TOKENS 100
 
 #ifndef TOKENS_H
 #define TOKENS_H
 
+// what a token was in the input; the values double as the tags of the
+// binary output of the tokenize demo
+typedef enum {
+  TOKEN_WORD = 'w',
+  TOKEN_STRING = 's',    // the contents of a double-quoted string
+  TOKEN_OPERATOR = 'o',  // one of ;<>()|
+  TOKEN_END_OF_LINE = 'e'
+} TokenKind;
+
 char *my_strdup(const char *s);
 extern void tokenize(char *input, char *tokens[], int *token_count);
+void setTokenKind(int kinds[], int index, int kind);
+char *copyToken(Arena *arena, const char *s);
+void tokenizeKinds(Arena *arena, char *input, char *tokens[], int kinds[],
+                   int *token_count);
 
 #endif
\ No newline at end of file